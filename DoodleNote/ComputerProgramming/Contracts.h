@@ -1,6 +1,13 @@
 #pragma once
 
 #include <cassert>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "../Implementations/Registry.h"
 
 // Hoare triple: A triple describes how the execution of a piece of
 // code changes the state of the computation.
@@ -37,6 +44,228 @@
 // Programmers often use assertions in their code to make invariants explicit.
 // 몇몇 객체지향언어는 class invariants 문법을 갖는다.
 
+// Contract checking levels.
+// assert는 NDEBUG에 따라 모두 켜지거나 모두 꺼진다. 여기서는 검사마다 비용 수준을 붙이고
+// CONTRACT_LEVEL로 어디까지 검사할지 compile time에 정한다.
+//   CONTRACT_LEVEL_OFF(0):     모든 검사를 없앤다. 조건식은 평가하지 않고 문법만 검사한다.
+//   CONTRACT_LEVEL_DEFAULT(1): 값싼 검사(EXPECTS, ENSURES, INVARIANT)만 켠다. release에서도 켜 두는 수준이다.
+//   CONTRACT_LEVEL_AUDIT(2):   비싼 검사(*_AUDIT)까지 켠다.
+// 지정하지 않으면 NDEBUG일 때 DEFAULT, 아니면 AUDIT이다.
+//
+// 위반하면 그 검사 위치(site)의 counter를 올리고 handler를 호출한다.
+// site는 처음 위반될 때 등록되므로 위반이 없으면 등록 비용도 없다.
+// Contracts::ForEachViolatedSite로 위반 횟수를 모니터링에 내보낼 수 있다.
+// 기본 handler는 site마다 처음 한 번만 std::cerr에 기록하고 계속 실행한다.
+// EXPECTS_OR_ABORT는 위반한 채로 계속하면 memory를 잘못 읽거나 쓰게 되는 곳에 쓴다.
+// EXPECTS와 같은 수준에서 켜지고 꺼지지만, 위반하면 handler를 호출한 뒤 돌아오지 않고 abort한다.
+// CONTRACT_LEVEL_OFF로 compile하면 다른 검사처럼 사라지므로 그때는 호출하는 쪽이 범위를 지켜야 한다.
+
+#define CONTRACT_LEVEL_OFF 0
+#define CONTRACT_LEVEL_DEFAULT 1
+#define CONTRACT_LEVEL_AUDIT 2
+
+#ifndef CONTRACT_LEVEL
+#ifdef NDEBUG
+#define CONTRACT_LEVEL CONTRACT_LEVEL_DEFAULT
+#else
+#define CONTRACT_LEVEL CONTRACT_LEVEL_AUDIT
+#endif
+#endif
+
+namespace Contracts
+{
+	enum class EKind { Precondition, Postcondition, Invariant };
+
+	inline const char* ToString(EKind Kind)
+	{
+		switch (Kind)
+		{
+		case EKind::Precondition:  return "precondition";
+		case EKind::Postcondition: return "postcondition";
+		default:                   return "invariant";
+		}
+	}
+
+	struct ViolationSite
+	{
+		const char* File;
+		int Line;
+		EKind Kind;
+		const char* Expression;
+		std::atomic<uint64_t> Count {0};
+		ViolationSite* Next = nullptr;
+
+		ViolationSite(const char* InFile, int InLine, EKind InKind, const char* InExpression);
+	};
+
+	using ViolationHandler = void (*)(const ViolationSite& Site, uint64_t Count);
+
+	inline void LogOnce(const ViolationSite& Site, uint64_t Count)
+	{
+		if (Count == 1)
+		{
+			std::cerr << "contract violation: " << ToString(Site.Kind) << " (" << Site.Expression << ") at "
+					  << Site.File << ":" << Site.Line << std::endl;
+		}
+	}
+
+	[[noreturn]] inline void Abort(const ViolationSite& Site, uint64_t Count)
+	{
+		LogOnce(Site, Count);
+		std::abort();
+	}
+
+	inline std::atomic<ViolationSite*> SiteList {nullptr};
+	inline std::atomic<ViolationHandler> Handler {LogOnce};
+
+	inline ViolationSite::ViolationSite(const char* InFile, int InLine, EKind InKind, const char* InExpression)
+		: File(InFile), Line(InLine), Kind(InKind), Expression(InExpression)
+	{
+		// lock-free push. site는 static 객체이므로 해제되지 않는다.
+		Next = SiteList.load(std::memory_order_relaxed);
+		while (!SiteList.compare_exchange_weak(Next, this, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	inline ViolationHandler SetViolationHandler(ViolationHandler NewHandler)
+	{
+		return Handler.exchange(NewHandler);
+	}
+
+	// 실패 경로는 inline되지 않게 하여 검사하는 쪽의 code를 작게 유지한다.
+#ifdef _MSC_VER
+	__declspec(noinline)
+#else
+	[[gnu::noinline, gnu::cold]]
+#endif
+	inline void Violated(ViolationSite& Site)
+	{
+		const uint64_t Count = Site.Count.fetch_add(1, std::memory_order_relaxed) + 1;
+		Handler.load(std::memory_order_acquire)(Site, Count);
+	}
+
+	// handler가 돌아오면 abort한다. handler가 예외를 던지면 그대로 전파된다.
+#ifdef _MSC_VER
+	__declspec(noinline)
+#else
+	[[gnu::noinline, gnu::cold]]
+#endif
+	[[noreturn]] inline void ViolatedFatal(ViolationSite& Site)
+	{
+		Violated(Site);
+		std::abort();
+	}
+
+	// 한 번이라도 위반된 site를 모두 방문한다.
+	template<class Func>
+	void ForEachViolatedSite(Func&& Visit)
+	{
+		for (ViolationSite* Site = SiteList.load(std::memory_order_acquire); Site; Site = Site->Next)
+		{
+			Visit(static_cast<const ViolationSite&>(*Site), Site->Count.load(std::memory_order_relaxed));
+		}
+	}
+}
+
+#define CONTRACT_CHECK_ENABLED(Kind, Condition) \
+	do { \
+		if (!(Condition)) [[unlikely]] { \
+			static ::Contracts::ViolationSite ContractSite(__FILE__, __LINE__, ::Contracts::EKind::Kind, #Condition); \
+			::Contracts::Violated(ContractSite); \
+		} \
+	} while (false)
+
+#define CONTRACT_CHECK_FATAL(Kind, Condition) \
+	do { \
+		if (!(Condition)) [[unlikely]] { \
+			static ::Contracts::ViolationSite ContractSite(__FILE__, __LINE__, ::Contracts::EKind::Kind, #Condition); \
+			::Contracts::ViolatedFatal(ContractSite); \
+		} \
+	} while (false)
+
+// 조건식을 평가하지 않지만 compile은 되어야 하므로 꺼진 검사도 깨진 채로 방치되지 않는다.
+#define CONTRACT_CHECK_DISABLED(Kind, Condition) ((void)sizeof(!(Condition)))
+
+#if CONTRACT_LEVEL >= CONTRACT_LEVEL_DEFAULT
+#define EXPECTS(Condition)   CONTRACT_CHECK_ENABLED(Precondition, Condition)
+#define ENSURES(Condition)   CONTRACT_CHECK_ENABLED(Postcondition, Condition)
+#define INVARIANT(Condition) CONTRACT_CHECK_ENABLED(Invariant, Condition)
+#define EXPECTS_OR_ABORT(Condition) CONTRACT_CHECK_FATAL(Precondition, Condition)
+#else
+#define EXPECTS(Condition)   CONTRACT_CHECK_DISABLED(Precondition, Condition)
+#define ENSURES(Condition)   CONTRACT_CHECK_DISABLED(Postcondition, Condition)
+#define INVARIANT(Condition) CONTRACT_CHECK_DISABLED(Invariant, Condition)
+#define EXPECTS_OR_ABORT(Condition) CONTRACT_CHECK_DISABLED(Precondition, Condition)
+#endif
+
+#if CONTRACT_LEVEL >= CONTRACT_LEVEL_AUDIT
+#define EXPECTS_AUDIT(Condition)   CONTRACT_CHECK_ENABLED(Precondition, Condition)
+#define ENSURES_AUDIT(Condition)   CONTRACT_CHECK_ENABLED(Postcondition, Condition)
+#define INVARIANT_AUDIT(Condition) CONTRACT_CHECK_ENABLED(Invariant, Condition)
+#else
+#define EXPECTS_AUDIT(Condition)   CONTRACT_CHECK_DISABLED(Precondition, Condition)
+#define ENSURES_AUDIT(Condition)   CONTRACT_CHECK_DISABLED(Postcondition, Condition)
+#define INVARIANT_AUDIT(Condition) CONTRACT_CHECK_DISABLED(Invariant, Condition)
+#endif
+
+namespace Contracts
+{
+	void Test()
+	{
+		const ViolationHandler Previous = SetViolationHandler([] (const ViolationSite&, uint64_t) {});
+		auto Check = [] (int Value) {
+			EXPECTS(Value >= 0);
+			return Value;
+		};
+		for (int i = -3; i < 3; i++) Check(i);
+		SetViolationHandler(Previous);
+
+		uint64_t Total = 0;
+		ForEachViolatedSite([&] (const ViolationSite& Site, uint64_t Count) {
+			std::cout << ToString(Site.Kind) << " (" << Site.Expression << ") at line " << Site.Line << ": " << Count << std::endl;
+			Total += Count;
+		});
+#if CONTRACT_LEVEL >= CONTRACT_LEVEL_DEFAULT
+		CHECK(Total >= 3);
+#endif
+	}
+	REGISTER_TEST(Test, "Contracts::Test", Test);
+
+	// 같은 hot loop를 검사 없이, 꺼진 검사(*_AUDIT, DEFAULT 수준에서 compile할 때)로, 켜진 검사로 돌려 비교한다.
+	// 꺼진 검사는 검사 없는 loop와 같은 시간이 나와야 한다.
+	void Benchmark()
+	{
+		constexpr int NumElements = 1 << 20;
+		constexpr int NumRepeats = 20;
+		std::vector<int> Values(NumElements);
+		std::vector<int> Indices(NumElements);
+		uint32_t Seed = 12345;
+		for (int i = 0; i < NumElements; i++)
+		{
+			Values[i] = i & 15;
+			Seed = Seed * 1664525u + 1013904223u;
+			Indices[i] = static_cast<int>(Seed % NumElements);
+		}
+		// compiler가 검사를 증명해서 없애지 못하도록 index를 data에서 읽는다.
+		const int* Data = Values.data();
+
+		auto Measure = [&] (const char* Name, auto&& At) {
+			long long Result = 0;
+			const auto Start = std::chrono::steady_clock::now();
+			for (int r = 0; r < NumRepeats; r++)
+				for (int i = 0; i < NumElements; i++) Result += At(Indices[i]);
+			const std::chrono::duration<double, std::nano> Elapsed = std::chrono::steady_clock::now() - Start;
+			std::cout << Name << ": " << Elapsed.count() / (double(NumElements) * NumRepeats) << " ns/element (sum " << Result << ")" << std::endl;
+		};
+
+		std::cout << "CONTRACT_LEVEL " << CONTRACT_LEVEL << std::endl;
+		Measure("no check     ", [&] (int i) { return Data[i]; });
+		Measure("EXPECTS_AUDIT", [&] (int i) { EXPECTS_AUDIT(0 <= i && i < NumElements); return Data[i]; });
+		Measure("EXPECTS      ", [&] (int i) { EXPECTS(0 <= i && i < NumElements); return Data[i]; });
+		Measure("assert       ", [&] (int i) { assert(0 <= i && i < NumElements); return Data[i]; });
+	}
+	REGISTER_BENCHMARK(Benchmark, "Contracts::Benchmark", Benchmark);
+}
+
 namespace Examples::Eiffel
 {
 	class Time
@@ -46,17 +275,18 @@ namespace Examples::Eiffel
 		void set_hour(int a_hour)
 		{
 			//1.required valid_argument(or precondition): 
-			assert(0 <= a_hour && a_hour <= 23);
+			EXPECTS(0 <= a_hour && a_hour <= 23);
 
 			//2.executions:
 			hour = a_hour;
 
 			//3.ensure(or postcondition):
-			assert(hour == a_hour);
+			ENSURES_AUDIT(hour == a_hour);
 		}
 	};
 }
 
+// 실제 문자열에 규칙을 적용하는 상태 공간 탐색은 Implementations/MuPuzzleExplorer.h에 있다.
 namespace Examples::MU_Puzzle
 {
 	void MUPuzzle()
@@ -73,7 +303,7 @@ namespace Examples::MU_Puzzle
 			case 4:				UCount -= 2; break;
 			}
 			// Computed invariant:
-			assert(ICount % 3 == 1 || ICount % 3 == 2);
+			INVARIANT(ICount % 3 == 1 || ICount % 3 == 2);
 		}
 	}
 }
\ No newline at end of file
@@ -14,6 +14,11 @@
 // obj->~ClassName();
 // 보통은 delete를 사용하여 소멸자를 자동호출한다.
 
+#include <chrono>
+#include <vector>
+#include "../Implementations/RegionArena.h"
+#include "../Implementations/Registry.h"
+
 namespace Nonpublic
 {
 	// 만약 소멸자가 public이 아니면,
@@ -226,4 +231,98 @@ namespace Public_Pure_Virtual
 
 	// AbstractBase obj; // compiler error
 	Derived obj;         // OK
-}
\ No newline at end of file
+}
+
+// 짧게 사는 다형적 객체를 대량으로 만들 때 사용한다.
+namespace Region_Allocated
+{
+	// Public_And_Virtual과 같은 계층이지만, 객체와 맴버를 모두 같은 Region에 만든다.
+	// 맴버는 Region이 소멸시키므로 소멸자에서 delete하지 않는다.
+	class Base
+	{
+		string* Name;
+	public:
+		explicit Base(Memory::Region& Region)
+		{
+			Name = Region.New<string>("base");
+		}
+		virtual ~Base() {}
+		const string& GetName() const { return *Name; }
+	};
+
+	class Derived: public Base
+	{
+		int* Integer;
+	public:
+		explicit Derived(Memory::Region& Region) : Base(Region)
+		{
+			Integer = Region.New<int>(5);
+		}
+		int GetInteger() const { return *Integer; }
+	};
+
+	void Region_Alloc()
+	{
+		Memory::Region Region;
+		Base* var = Region.New<Derived>(Region);
+		cout << var->GetName() << endl;
+		// delete하지 않는다. Reset이나 Region의 소멸자가 ~Derived, ~Base, ~string을 차례로 호출한다.
+		Region.Reset();
+	}
+	REGISTER_TEST(Region_Alloc, "Region_Allocated::Region_Alloc", Region_Alloc);
+
+	// 매 frame 백만 개의 객체를 만들고 없앤다.
+	// 개별 new/delete(객체, string, int마다 할당)와 Region을 비교한다.
+	void Benchmark()
+	{
+		class HeapBase
+		{
+			string* Name;
+		public:
+			HeapBase() { Name = new string { "base" }; }
+			virtual ~HeapBase() { delete Name; }
+		};
+		class HeapDerived: public HeapBase
+		{
+			int* Integer;
+		public:
+			HeapDerived() { Integer = new int { 5 }; }
+			virtual ~HeapDerived() override { delete Integer; }
+		};
+
+		constexpr int NumFrames = 5;
+		constexpr int NumObjects = 1000000;
+		vector<void*> Objects(NumObjects);
+		auto Elapsed = [] (auto Start) {
+			return chrono::duration<double, milli>(chrono::steady_clock::now() - Start).count();
+		};
+
+		double HeapCreate = 0, HeapDestroy = 0;
+		for (int Frame = 0; Frame < NumFrames; Frame++)
+		{
+			auto Start = chrono::steady_clock::now();
+			for (auto& Object : Objects) Object = static_cast<HeapBase*>(new HeapDerived);
+			HeapCreate += Elapsed(Start);
+			Start = chrono::steady_clock::now();
+			for (auto& Object : Objects) delete static_cast<HeapBase*>(Object);
+			HeapDestroy += Elapsed(Start);
+		}
+
+		double RegionCreate = 0, RegionDestroy = 0;
+		Memory::Region Region;
+		for (int Frame = 0; Frame < NumFrames; Frame++)
+		{
+			auto Start = chrono::steady_clock::now();
+			for (auto& Object : Objects) Object = static_cast<Base*>(Region.New<Derived>(Region));
+			RegionCreate += Elapsed(Start);
+			Start = chrono::steady_clock::now();
+			Region.Reset();
+			RegionDestroy += Elapsed(Start);
+		}
+
+		cout << "new/delete: create " << HeapCreate / NumFrames << " ms, destroy " << HeapDestroy / NumFrames << " ms per frame" << endl;
+		cout << "Region:     create " << RegionCreate / NumFrames << " ms, destroy " << RegionDestroy / NumFrames << " ms per frame ("
+			 << Region.ChunkCount() << " chunks)" << endl;
+	}
+	REGISTER_BENCHMARK(Benchmark, "Region_Allocated::Benchmark", Benchmark);
+}
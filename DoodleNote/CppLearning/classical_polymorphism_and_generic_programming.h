@@ -1,17 +1,40 @@
 #pragma once
 
 #include <iostream>
+#include <iomanip>
 #include <cassert>
+#include <chrono>
+#include <span>
+#include <string>
 #include <vector>
 #include <initializer_list>
+#include <algorithm>
+#include <concepts>
+#include <iterator>
+#include <functional>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+#include "../ComputerProgramming/Contracts.h"
+#include "../Implementations/SimdKernels.h"
+#include "../Implementations/SmallArray.h"
+#include "../Implementations/NodePool.h"
+#include "../Implementations/ThreadPool.h"
+#include "../Implementations/Registry.h"
 
 namespace Monomorphic
 {
     class ArrayOfInt
     {
-        int Data[5] ={1,2,3,4,5};
+        int Datas[5] ={1,2,3,4,5};
     public:
         int Size() const { return 5; }
+        int* Data() { return Datas; }
+        const int* Data() const { return Datas; }
+        int* begin() { return Datas; }
+        int* end() { return Datas + 5; }
+        const int* begin() const { return Datas; }
+        const int* end() const { return Datas + 5; }
 
         int& operator[](int i) 
         { 
@@ -20,27 +43,21 @@ namespace Monomorphic
 
         const int& operator[](int i) const
         { 
-            assert(0 <= i && i < 5);
-            return Data[i]; 
+            // 위반한 채 계속하면 배열 밖을 읽으므로 handler가 돌아와도 멈춘다. 검사 여부는 CONTRACT_LEVEL을 따른다.
+            EXPECTS_OR_ABORT(0 <= i && i < 5);
+            return Datas[i]; 
         }
     };
 
+    // 연속된 storage이므로 operator[]의 assert를 거치지 않고 vectorized kernel에 넘긴다.
     int Sum(const ArrayOfInt& Array)
     {
-        int Result = 0;
-        for (int i = 0; i < Array.Size(); i++)
-        {
-            Result += Array[i];
-        }
-        return Result;
+        return Simd::Sum(Array.Data(), Array.Size());
     }
 
     void Multiply(ArrayOfInt& ArrayRef, int Factor)
     {
-        for (int i = 0; i < ArrayRef.Size(); i++)
-        {
-            ArrayRef[i] *= Factor;
-        }
+        Simd::Scale(ArrayRef.Data(), ArrayRef.Size(), Factor);
     }
 
     void Test()
@@ -59,14 +76,34 @@ namespace Monomorphic
         std::cout << "Sum: " << Sum(Array) << std::endl;
         Multiply(Array, 2);
         PrintArray("Array Multiplied: ");
+
+#if CONTRACT_LEVEL >= CONTRACT_LEVEL_DEFAULT
+        // 범위를 벗어나면 배열 밖을 읽기 전에 멈춘다. 여기서는 abort 대신 handler가 던지게 해서 확인한다.
+        const auto Previous = Contracts::SetViolationHandler([] (const Contracts::ViolationSite&, uint64_t) {
+            throw std::out_of_range("ArrayOfInt");
+        });
+        bool bStopped = false;
+        try { (void)Array[5]; } catch (const std::out_of_range&) { bStopped = true; }
+        Contracts::SetViolationHandler(Previous);
+        CHECK(bStopped);
+#endif
     }
+    REGISTER_TEST(Test, "Monomorphic::Test", Test);
 }
 
 namespace Polymorphic
 {
+    // NextBlock이 어디까지 넘겼는지를 기억한다. 의미는 container마다 다르다.
+    struct BlockCursor
+    {
+        const void* Next = nullptr;
+        int Index = 0;
+    };
+
     class ContainerOfInt
     {
     public:
+        virtual ~ContainerOfInt() = default;
         virtual int Size() const = 0;
         int& operator[](int i)
         {
@@ -74,99 +111,178 @@ namespace Polymorphic
         }
         virtual const int& operator[](int) const = 0;
         virtual void Add(int) = 0;
+
+        // 원소를 연속된 구간(block) 단위로 차례로 넘긴다. 끝나면 빈 span을 돌려준다.
+        // 알고리즘은 block마다 virtual 호출을 한 번만 하고, block 안에서는 inline되고
+        // vectorize될 수 있는 loop를 돈다.
+        std::span<int> NextBlock(BlockCursor& Cursor)
+        {
+            const std::span<const int> Block = static_cast<const ContainerOfInt*>(this)->NextBlock(Cursor);
+            return {const_cast<int*>(Block.data()), Block.size()};
+        }
+        virtual std::span<const int> NextBlock(BlockCursor& Cursor) const = 0;
     };
 
     class ArrayOfInt: public ContainerOfInt
     {
-        int* Datas = nullptr;
-        int Capacity = 10;
-        int Length = 0;
+        // 16개까지는 객체 안에 저장하고, 넘치면 realloc으로 두 배씩 늘린다.
+        Containers::SmallArray<int, 16> Datas;
     public:
-        ArrayOfInt() { Datas = new int[Capacity]; }
-        ~ArrayOfInt()
-        {
-            delete[] Datas;
-            Datas = nullptr;
-        }
+        void Reserve(int NewCapacity) { Datas.reserve(static_cast<size_t>(NewCapacity)); }
+        void Append(std::span<const int> Values) { Datas.Append(Values); }
+        int Capacity() const { return static_cast<int>(Datas.capacity()); }
+        size_t AllocationCount() const { return Datas.AllocationCount(); }
+
+        // 정적 dispatch로 순회할 때 쓴다. 원소가 연속되어 있으므로 pointer가 곧 iterator다.
+        int* begin() { return Datas.begin(); }
+        int* end() { return Datas.end(); }
+        const int* begin() const { return Datas.begin(); }
+        const int* end() const { return Datas.end(); }
 
         //~ Begin ContainerOfInt Interface.
-        virtual int Size() const override { return Length; }
+        virtual int Size() const override { return static_cast<int>(Datas.size()); }
         using ContainerOfInt::operator[];
-        virtual const int& operator[](int i) const override { return Datas[i]; }
-        virtual void Add(int InData) override
+        virtual const int& operator[](int i) const override { return Datas[static_cast<size_t>(i)]; }
+        using ContainerOfInt::NextBlock;
+        virtual std::span<const int> NextBlock(BlockCursor& Cursor) const override
         {
-            if (Capacity <= Length)
-            {
-                const int NewCapacity = Capacity * 2;
-                if (int* NewDatas = new(std::nothrow) int[NewCapacity])
-                {
-                    for (int i = 0; i < Length; i++)
-                    {
-                        NewDatas[i] = Datas[i];
-                    }
-                    delete[] Datas;
-                    Datas = NewDatas;
-                    Capacity = NewCapacity;
-                }
-            }
-            Datas[Length++] = InData;
+            // 전체가 하나의 block이다.
+            const int Begin = Cursor.Index;
+            Cursor.Index = Size();
+            return {Datas.data() + Begin, Datas.size() - static_cast<size_t>(Begin)};
         }
+        virtual void Add(int InData) override { Datas.push_back(InData); }
         //~ End ContainerOfInt Interface.
     };
 
     class ListOfInt: public ContainerOfInt
     {
+        // unrolled linked list: node 하나에 여러 int를 담는다.
+        // Add는 항상 끝에 추가하므로 마지막 node를 제외한 모든 node는 가득 차 있다.
+        static constexpr int NodeCapacity = 16;
         struct Node
         {
-            int Data;
+            int Data[NodeCapacity];
+            int Count;
             Node* Next;
         };
+        // node는 pool의 slab에서 할당하고, list가 파괴될 때 slab째로 돌려준다.
+        // slab은 작게 시작해서 커지므로 원소가 몇 개 없는 list는 작은 slab 하나만 쓴다.
+        Containers::NodePool<Node> Pool;
         Node* Root = nullptr;
         Node* Last = nullptr;
-        int NumNode = 0;
+        int NumElement = 0;
+
+        // 마지막으로 접근한 node와 그 node의 첫 index.
+        // 다음 접근이 같은 node나 그 뒤라면 Root부터 다시 따라가지 않는다.
+        // const 접근에서도 갱신하므로 여러 thread에서 동시에 읽으면 안된다.
+        mutable Node* CursorNode = nullptr;
+        mutable int CursorBase = 0;
 
     public:
-        ~ListOfInt()
+        // node 안의 원소를 차례로 지나고, node 끝에서 다음 node로 넘어가는 forward iterator.
+        template <class ValueType>
+        class Iterator
         {
-            Node* Temp;
-            while (Root)
+            using NodeType = std::conditional_t<std::is_const_v<ValueType>, const Node, Node>;
+            NodeType* Current = nullptr;
+            int Index = 0;
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = int;
+            using difference_type = std::ptrdiff_t;
+            using reference = ValueType&;
+            using pointer = ValueType*;
+
+            Iterator() = default;
+            explicit Iterator(NodeType* InNode) : Current(InNode) {}
+
+            reference operator*() const { return Current->Data[Index]; }
+            Iterator& operator++()
             {
-                Temp = Root;
-                Root = Root->Next;
-                delete Temp;
+                if (++Index == Current->Count)
+                {
+                    Current = Current->Next;
+                    Index = 0;
+                }
+                return *this;
             }
-            Temp = nullptr;
-        }
+            Iterator operator++(int)
+            {
+                Iterator Temp = *this;
+                ++*this;
+                return Temp;
+            }
+            bool operator==(const Iterator&) const = default;
+        };
+        using iterator = Iterator<int>;
+        using const_iterator = Iterator<const int>;
+
+        iterator begin() { return iterator(Root); }
+        iterator end() { return iterator(); }
+        const_iterator begin() const { return const_iterator(Root); }
+        const_iterator end() const { return const_iterator(); }
+
+        ListOfInt() = default;
+        ListOfInt(const ListOfInt&) = delete;
+        ListOfInt& operator=(const ListOfInt&) = delete;
+        // Node는 trivially destructible이므로 node마다 delete하지 않는다. ~NodePool이 slab을 한꺼번에 돌려준다.
+        static_assert(std::is_trivially_destructible_v<Node>);
+
+        // node를 위해 잡아 둔 메모리의 크기.
+        size_t ReservedBytes() const { return Pool.ReservedBytes(); }
 
         //~ Begin ContainerOfInt Interface.
-        virtual int Size() const override { return NumNode; }
+        virtual int Size() const override { return NumElement; }
         using ContainerOfInt::operator[];
         virtual const int& operator[](int i) const override
         {
-            assert(0 <= i && i < NumNode);
-            Node* Node = Root;
-            for (int Count = 0; Count < i; Count++)
+            assert(0 <= i && i < NumElement);
+            if (!CursorNode || i < CursorBase)
+            {
+                CursorNode = Root;
+                CursorBase = 0;
+            }
+            while (i >= CursorBase + CursorNode->Count)
             {
-                Node = Node->Next;
+                CursorBase += CursorNode->Count;
+                CursorNode = CursorNode->Next;
             }
-            return Node->Data;
+            return CursorNode->Data[i - CursorBase];
+        }
+        using ContainerOfInt::NextBlock;
+        virtual std::span<const int> NextBlock(BlockCursor& Cursor) const override
+        {
+            // node 하나가 하나의 block이다.
+            const Node* Current = Cursor.Index == 0 ? Root : static_cast<const Node*>(Cursor.Next);
+            if (!Current) return {};
+            Cursor.Index += Current->Count;
+            Cursor.Next = Current->Next;
+            return {Current->Data, static_cast<size_t>(Current->Count)};
         }
         virtual void Add(int InData) override
         {
-            if (Node* NewNode = new(std::nothrow) Node{InData, nullptr})
+            if (Last && Last->Count < NodeCapacity)
+            {
+                Last->Data[Last->Count++] = InData;
+                NumElement++;
+            }
+            else
             {
+                Node* NewNode = Pool.New(Node{{InData}, 1, nullptr});
                 if (Last) Last = (Last->Next = NewNode);
                 else Root = Last = NewNode;
-                NumNode++;
+                NumElement++;
             }
         }
         //~ End ContainerOfInt Interface.
     };
 
-    int Sum(const ContainerOfInt& Container)
+    // 원소마다 virtual Size()와 virtual operator[]를 호출한다.
+    int SumByIndex(const ContainerOfInt& Container)
     {
         // ArrayOfInt: T(n) = Theta(n)
-        // ListOfInt:  T(n) = Theta(n^2)
+        // ListOfInt:  T(n) = Theta(n), 순차 접근은 cursor 덕분에 amortized O(1)이다.
         int Result = 0;
         for (int i = 0; i < Container.Size(); i++)
         {
@@ -175,13 +291,28 @@ namespace Polymorphic
         return Result;
     }
 
+    // block마다 virtual 호출을 한 번만 한다.
+    int Sum(const ContainerOfInt& Container)
+    {
+        // ArrayOfInt: T(n) = Theta(n)
+        // ListOfInt:  T(n) = Theta(n)
+        int Result = 0;
+        BlockCursor Cursor;
+        for (auto Block = Container.NextBlock(Cursor); !Block.empty(); Block = Container.NextBlock(Cursor))
+        {
+            Result += Simd::Sum(Block.data(), Block.size());
+        }
+        return Result;
+    }
+
     void Multiply(ContainerOfInt& ContainerRef, int Factor)
     {
         // ArrayOfInt: T(n) = Theta(n)
-        // ListOfInt:  T(n) = Theta(n^2)
-        for (int i = 0; i < ContainerRef.Size(); i++)
+        // ListOfInt:  T(n) = Theta(n)
+        BlockCursor Cursor;
+        for (auto Block = ContainerRef.NextBlock(Cursor); !Block.empty(); Block = ContainerRef.NextBlock(Cursor))
         {
-            ContainerRef[i] *= Factor;
+            Simd::Scale(Block.data(), Block.size(), Factor);
         }
     }
 
@@ -219,17 +350,364 @@ namespace Polymorphic
         }
         Print("Array: ", Array);
         Print("List: ", List);
+
+        // 원소가 하나뿐인 list가 많아도 list마다 가장 작은 slab 하나만 잡는다.
+        std::vector<ListOfInt> SmallLists(10000);
+        size_t TotalBytes = 0;
+        for (ListOfInt& Each : SmallLists) {
+            Each.Add(1);
+            TotalBytes += Each.ReservedBytes();
+        }
+        CHECK(TotalBytes == SmallLists.size() * Containers::SlabCache::MinSlabBytes);
     }
+    REGISTER_TEST(Test, "Polymorphic::Test", Test);
+
+    // 원소마다 virtual 호출하는 SumByIndex와 block마다 호출하는 Sum을 비교한다.
+    void BenchmarkSum()
+    {
+        constexpr int NumElements = 1000000;
+        ArrayOfInt Array;
+        ListOfInt List;
+        for (int i = 0; i < NumElements; i++) {
+            Array.Add(i % 7);
+            List.Add(i % 7);
+        }
+
+        auto Measure = [] (const char* Name, auto&& SumFunction, const ContainerOfInt& Container) {
+            const auto Start = std::chrono::steady_clock::now();
+            const int Result = SumFunction(Container);
+            const std::chrono::duration<double, std::micro> Elapsed = std::chrono::steady_clock::now() - Start;
+            std::cout << Name << ": Sum " << Result << " in " << Elapsed.count() << " us" << std::endl;
+        };
+        Measure("Array, per element", SumByIndex, Array);
+        Measure("Array, per block  ", Sum, Array);
+        Measure("List,  per element", SumByIndex, List);
+        Measure("List,  per block  ", Sum, List);
+    }
+    REGISTER_BENCHMARK(BenchmarkSum, "Polymorphic::BenchmarkSum", BenchmarkSum);
+
+    // node마다 new/delete하는 list와 NodePool을 쓰는 ListOfInt의 생성, 순회, 파괴 시간을 비교한다.
+    // cache miss는 hardware counter 없이 잴 수 없으므로, 다음 node가 바로 뒤 주소에 있는 비율을 locality 지표로 보여준다.
+    void BenchmarkList()
+    {
+        struct HeapNode
+        {
+            int Data[16];
+            int Count;
+            HeapNode* Next;
+        };
+        constexpr int NumElements = 4000000;
+        constexpr int NumRounds = 3;
+
+        auto Elapsed = [] (auto Start) {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+        };
+        auto Report = [] (const char* Name, double Build, double Traverse, double Destroy, double Adjacent, long long Result) {
+            std::cout << Name << ": build " << Build << " ms, traverse " << Traverse << " ms, destroy " << Destroy
+                      << " ms, adjacent nodes " << Adjacent * 100 << "% (sum " << Result << ")" << std::endl;
+        };
+
+        // 다른 할당이 섞여 있는 heap을 흉내내기 위해 node 사이사이에 짧게 사는 객체를 만든다.
+        std::vector<std::string> Noise;
+        auto MakeNoise = [&Noise] (int i) {
+            if (i % 64 == 0) Noise.emplace_back(48, 'x');
+            if (Noise.size() > 256) Noise.erase(Noise.begin(), Noise.begin() + 128);
+        };
+
+        for (int Round = 0; Round < NumRounds; Round++)
+        {
+            std::cout << "[Round " << Round << "]" << std::endl;
+            {
+                auto Start = std::chrono::steady_clock::now();
+                HeapNode* Root = nullptr;
+                HeapNode* Last = nullptr;
+                for (int i = 0; i < NumElements; i++)
+                {
+                    MakeNoise(i);
+                    if (Last && Last->Count < 16) Last->Data[Last->Count++] = i % 7;
+                    else
+                    {
+                        HeapNode* NewNode = new HeapNode{{i % 7}, 1, nullptr};
+                        if (Last) Last = (Last->Next = NewNode);
+                        else Root = Last = NewNode;
+                    }
+                }
+                const double Build = Elapsed(Start);
+
+                Start = std::chrono::steady_clock::now();
+                long long Result = 0;
+                size_t Adjacent = 0, NumNodes = 0;
+                for (HeapNode* Node = Root; Node; Node = Node->Next)
+                {
+                    Result += Simd::Sum(Node->Data, static_cast<size_t>(Node->Count));
+                    Adjacent += Node->Next == Node + 1;
+                    NumNodes++;
+                }
+                const double Traverse = Elapsed(Start);
+
+                Start = std::chrono::steady_clock::now();
+                while (Root)
+                {
+                    HeapNode* Temp = Root;
+                    Root = Root->Next;
+                    delete Temp;
+                }
+                Report("  new/delete", Build, Traverse, Elapsed(Start), double(Adjacent) / NumNodes, Result);
+            }
+            {
+                auto Start = std::chrono::steady_clock::now();
+                auto* List = new ListOfInt;
+                for (int i = 0; i < NumElements; i++)
+                {
+                    MakeNoise(i);
+                    List->Add(i % 7);
+                }
+                const double Build = Elapsed(Start);
+
+                Start = std::chrono::steady_clock::now();
+                long long Result = 0;
+                size_t Adjacent = 0, NumNodes = 0;
+                BlockCursor Cursor;
+                for (auto Block = List->NextBlock(Cursor); !Block.empty(); Block = List->NextBlock(Cursor))
+                {
+                    Result += Simd::Sum(Block.data(), Block.size());
+                    Adjacent += Cursor.Next && static_cast<const char*>(Cursor.Next) - reinterpret_cast<const char*>(Block.data()) == sizeof(HeapNode);
+                    NumNodes++;
+                }
+                const double Traverse = Elapsed(Start);
+
+                Start = std::chrono::steady_clock::now();
+                delete List;
+                Report("  NodePool  ", Build, Traverse, Elapsed(Start), double(Adjacent) / NumNodes, Result);
+            }
+        }
+    }
+    REGISTER_BENCHMARK(BenchmarkList, "Polymorphic::BenchmarkList", BenchmarkList);
+
+    // 이전의 ArrayOfInt(capacity 10에서 시작해 new[]와 원소 단위 복사로 두 배씩 늘림)와 비교한다.
+    void BenchmarkAdd()
+    {
+        class LegacyArrayOfInt
+        {
+            int* Datas = new int[10];
+            int Capacity = 10;
+            int Length = 0;
+        public:
+            size_t Allocations = 1;
+            ~LegacyArrayOfInt() { delete[] Datas; }
+            void Add(int InData)
+            {
+                if (Capacity <= Length)
+                {
+                    int* NewDatas = new int[Capacity * 2];
+                    for (int i = 0; i < Length; i++) NewDatas[i] = Datas[i];
+                    delete[] Datas;
+                    Datas = NewDatas;
+                    Capacity *= 2;
+                    Allocations++;
+                }
+                Datas[Length++] = InData;
+            }
+        };
+
+        auto Measure = [] (const char* Name, int NumArrays, int NumAdds, auto&& Build) {
+            size_t Allocations = 0;
+            const auto Start = std::chrono::steady_clock::now();
+            for (int a = 0; a < NumArrays; a++) Allocations += Build(NumAdds);
+            const std::chrono::duration<double, std::nano> Elapsed = std::chrono::steady_clock::now() - Start;
+            std::cout << Name << ": " << Elapsed.count() / (double(NumArrays) * NumAdds) << " ns/add, "
+                      << double(Allocations) / NumArrays << " allocations/array" << std::endl;
+        };
+
+        auto Legacy = [] (int N) { LegacyArrayOfInt Array; for (int i = 0; i < N; i++) Array.Add(i); return Array.Allocations; };
+        auto Current = [] (int N) { ArrayOfInt Array; for (int i = 0; i < N; i++) Array.Add(i); return Array.AllocationCount(); };
+        auto Reserved = [] (int N) { ArrayOfInt Array; Array.Reserve(N); for (int i = 0; i < N; i++) Array.Add(i); return Array.AllocationCount(); };
+        int Chunk[256];
+        for (int i = 0; i < 256; i++) Chunk[i] = i;
+        auto Appended = [&Chunk] (int N) {
+            ArrayOfInt Array;
+            for (int i = 0; i < N; i += 256) Array.Append(std::span<const int>(Chunk, static_cast<size_t>(std::min(256, N - i))));
+            return Array.AllocationCount();
+        };
+
+        for (auto [NumArrays, NumAdds] : { std::pair{200000, 12}, std::pair{20, 1000000} })
+        {
+            std::cout << "[" << NumArrays << " arrays x " << NumAdds << " adds]" << std::endl;
+            Measure("  Legacy  ", NumArrays, NumAdds, Legacy);
+            Measure("  Add     ", NumArrays, NumAdds, Current);
+            Measure("  Reserve ", NumArrays, NumAdds, Reserved);
+            Measure("  Append  ", NumArrays, NumAdds, Appended);
+        }
+    }
+    REGISTER_BENCHMARK(BenchmarkAdd, "Polymorphic::BenchmarkAdd", BenchmarkAdd);
 }
 
 namespace Generic
 {
-    template <class InContainerType, class InFactorType>
+    // 아래 알고리즘은 virtual 호출 없이 container의 iterator로 순회한다.
+    // 어떤 container든 begin()/end()만 있으면 되고, 호출할 함수는 compile time에 정해진다.
+    // 원소가 연속되어 있으면(contiguous_range) Simd kernel로 넘긴다.
+
+    // 원소를 순서대로 읽을 수 있는 container.
+    template <class ContainerType>
+    concept IterableContainer = std::ranges::input_range<ContainerType>;
+
+    // 원소를 제자리에서 바꿀 수 있는 container.
+    template <class ContainerType>
+    concept MutableContainer = std::ranges::forward_range<ContainerType> &&
+        std::is_lvalue_reference_v<std::ranges::range_reference_t<ContainerType>> &&
+        !std::is_const_v<std::remove_reference_t<std::ranges::range_reference_t<ContainerType>>>;
+
+    // Simd kernel이 같은 결과를 낼 수 있는 원소와 factor의 조합.
+    // int는 정수 factor만, float는 산술 factor를 float로 바꾸어 곱할 때와 결과가 같다.
+    template <class ElementType, class FactorType>
+    concept SimdScalable =
+        (std::same_as<ElementType, int> && std::integral<FactorType> && sizeof(FactorType) <= sizeof(int)) ||
+        (std::same_as<ElementType, float> && std::same_as<FactorType, float>);
+
+    template <class ContainerType>
+    using ElementOf = std::ranges::range_value_t<ContainerType>;
+
+    template <IterableContainer InContainerType, class ValueType, class BinaryOperation>
+        requires std::invocable<BinaryOperation&, ValueType, std::ranges::range_reference_t<const InContainerType>>
+    ValueType Reduce(const InContainerType& Container, ValueType Init, BinaryOperation Operation)
+    {
+        for (auto&& Value : Container)
+        {
+            Init = Operation(std::move(Init), Value);
+        }
+        return Init;
+    }
+
+    template <IterableContainer InContainerType>
+    ElementOf<InContainerType> Sum(const InContainerType& Container)
+    {
+        using ElementType = ElementOf<InContainerType>;
+        if constexpr (std::ranges::contiguous_range<const InContainerType> &&
+                      (std::same_as<ElementType, int> || std::same_as<ElementType, float>))
+        {
+            return Simd::Sum(std::ranges::data(Container), std::ranges::size(Container));
+        }
+        else
+        {
+            return Reduce(Container, ElementType{}, std::plus<>{});
+        }
+    }
+
+    // 원소마다 Function의 결과로 바꾼다.
+    template <MutableContainer InContainerType, class FunctionType>
+        requires std::invocable<FunctionType&, ElementOf<InContainerType>&>
+    void Transform(InContainerType& Container, FunctionType&& Function)
+    {
+        for (auto& Value : Container)
+        {
+            Value = Function(Value);
+        }
+    }
+
+    template <MutableContainer InContainerType, class InFactorType>
+        requires requires(ElementOf<InContainerType>& Value, InFactorType&& Factor) { Value *= Factor; }
     void Multiply(InContainerType& Container,InFactorType&& Factor)
     {
-        for (int i = 0; i < Container.Size(); i++)
+        using FactorType = std::remove_cvref_t<InFactorType>;
+        if constexpr (std::ranges::contiguous_range<InContainerType> && SimdScalable<ElementOf<InContainerType>, FactorType>)
+        {
+            Simd::Scale(std::ranges::data(Container), std::ranges::size(Container), Factor);
+        }
+        else
+        {
+            for (auto& Value : Container)
+            {
+                Value *= Factor;
+            }
+        }
+    }
+
+    // Y[i] += A * X[i]. 둘 다 연속된 int/float storage면 fused multiply-add kernel을 쓴다.
+    template <MutableContainer InContainerType, class InFactorType>
+    void MultiplyAdd(InContainerType& Y, const InContainerType& X, InFactorType&& A)
+    {
+        using FactorType = std::remove_cvref_t<InFactorType>;
+        if constexpr (std::ranges::contiguous_range<InContainerType> && SimdScalable<ElementOf<InContainerType>, FactorType>)
+        {
+            assert(std::ranges::size(Y) == std::ranges::size(X));
+            Simd::MultiplyAdd(std::ranges::data(Y), std::ranges::data(X), std::ranges::size(Y), A);
+        }
+        else
+        {
+            auto Source = std::ranges::begin(X);
+            for (auto& Value : Y)
+            {
+                assert(Source != std::ranges::end(X));
+                Value += A * *Source++;
+            }
+        }
+    }
+
+    // 아래 Parallel 알고리즘은 연속된 container를 cache 크기(Parallel::ChunkBytes)의 chunk로 나누어
+    // 공유 thread pool에서 처리한다. 연속되지 않은 container는 한 thread에서 처리한다.
+    // chunk 경계는 원소 수로만 정해지고 부분 결과는 chunk 순서대로 합치므로,
+    // float 합도 thread 수나 scheduling과 무관하게 같은 기계에서는 항상 같은 값이 나온다.
+
+    template <class ContainerType>
+    constexpr size_t ChunkSizeOf = std::max<size_t>(Parallel::ChunkBytes / sizeof(ElementOf<ContainerType>), 1);
+
+    template <MutableContainer InContainerType, class InFactorType>
+        requires requires(ElementOf<InContainerType>& Value, InFactorType&& Factor) { Value *= Factor; }
+    void ParallelMultiply(InContainerType& Container, InFactorType&& Factor, Parallel::ThreadPool& Pool = Parallel::ThreadPool::Shared())
+    {
+        if constexpr (std::ranges::contiguous_range<InContainerType>)
+        {
+            auto* Data = std::ranges::data(Container);
+            Pool.ParallelFor(std::ranges::size(Container), ChunkSizeOf<InContainerType>, [&] (size_t Begin, size_t End) {
+                std::span Chunk(Data + Begin, End - Begin);
+                Multiply(Chunk, Factor);
+            });
+        }
+        else
+        {
+            Multiply(Container, Factor);
+        }
+    }
+
+    // Operation은 결합 법칙을 만족해야 한다. chunk마다 첫 원소부터 접은 뒤 Init에 chunk 순서대로 합친다.
+    template <IterableContainer InContainerType, class ValueType, class BinaryOperation>
+        requires std::invocable<BinaryOperation&, ValueType, std::ranges::range_reference_t<const InContainerType>> &&
+                 std::invocable<BinaryOperation&, ValueType, ValueType>
+    ValueType ParallelReduce(const InContainerType& Container, ValueType Init, BinaryOperation Operation,
+                             Parallel::ThreadPool& Pool = Parallel::ThreadPool::Shared())
+    {
+        if constexpr (std::ranges::contiguous_range<const InContainerType>)
+        {
+            const auto* Data = std::ranges::data(Container);
+            return Pool.ParallelReduce(std::ranges::size(Container), ChunkSizeOf<InContainerType>, std::move(Init),
+                [&] (size_t Begin, size_t End) {
+                    ValueType Partial(Data[Begin]);
+                    for (size_t i = Begin + 1; i < End; i++) Partial = Operation(std::move(Partial), Data[i]);
+                    return Partial;
+                },
+                Operation);
+        }
+        else
+        {
+            return Reduce(Container, std::move(Init), Operation);
+        }
+    }
+
+    template <IterableContainer InContainerType>
+    ElementOf<InContainerType> ParallelSum(const InContainerType& Container, Parallel::ThreadPool& Pool = Parallel::ThreadPool::Shared())
+    {
+        using ElementType = ElementOf<InContainerType>;
+        if constexpr (std::ranges::contiguous_range<const InContainerType>)
         {
-            Container[i] *= Factor;
+            const auto* Data = std::ranges::data(Container);
+            return Pool.ParallelReduce(std::ranges::size(Container), ChunkSizeOf<InContainerType>, ElementType{},
+                [&] (size_t Begin, size_t End) { return Sum(std::span(Data + Begin, End - Begin)); },
+                std::plus<>{});
+        }
+        else
+        {
+            return Sum(Container);
         }
     }
 
@@ -237,6 +715,7 @@ namespace Generic
     {
     public:
         DamageArray(std::initializer_list<float> Init) : std::vector<float>(Init) {}
+        explicit DamageArray(size_t Count, float Value = 0.f) : std::vector<float>(Count, Value) {}
         int Size() const { return static_cast<int>(size()); }
     };
 
@@ -268,5 +747,140 @@ namespace Generic
         Print("Array: ", Array);
         Print("List: ", List);
         Print("std::vector: ", DamagesToApply);
+
+        // 같은 알고리즘이 virtual 호출 없이 네 종류의 container에 모두 적용된다.
+        Monomorphic::ArrayOfInt FixedArray;
+        Transform(FixedArray, [] (int Value) { return Value * Value; });
+        Transform(List, [] (int Value) { return -Value; });
+        std::cout << "Sum of FixedArray: " << Sum(FixedArray) << std::endl;
+        std::cout << "Sum of Array: " << Sum(Array) << std::endl;
+        std::cout << "Sum of List: " << Sum(List) << std::endl;
+        std::cout << "Sum of std::vector: " << Sum(DamagesToApply) << std::endl;
+        std::cout << "Max of List: " << Reduce(List, 0, [] (int A, int B) { return std::max(A, B); }) << std::endl;
     }
-}
\ No newline at end of file
+    REGISTER_TEST(Test, "Generic::Test", Test);
+
+    // container 종류마다 virtual dispatch(원소마다, block마다)와 static dispatch를 비교한다.
+    void BenchmarkDispatch()
+    {
+        constexpr int NumElements = 1000000;
+        constexpr int NumRepeats = 20;
+        Polymorphic::ArrayOfInt Array;
+        Polymorphic::ListOfInt List;
+        DamageArray Damages(NumElements);
+        for (int i = 0; i < NumElements; i++) {
+            Array.Add(i % 7);
+            List.Add(i % 7);
+            Damages[i] = static_cast<float>(i % 7);
+        }
+
+        // 최적화로 container의 실제 type이 드러나 virtual 호출이 사라지지 않도록 base pointer를 volatile에 거쳐 넘긴다.
+        auto Hide = [] (Polymorphic::ContainerOfInt* Container) {
+            Polymorphic::ContainerOfInt* volatile Hidden = Container;
+            return Hidden;
+        };
+        auto Measure = [] (auto&& Function) {
+            double Result = 0;
+            const auto Start = std::chrono::steady_clock::now();
+            for (int r = 0; r < NumRepeats; r++) Result += Function();
+            const std::chrono::duration<double, std::nano> Elapsed = std::chrono::steady_clock::now() - Start;
+            return std::pair{Elapsed.count() / (double(NumElements) * NumRepeats), Result};
+        };
+        auto Print = [] (const char* Name, std::pair<double, double> Virtual, std::pair<double, double> Block, std::pair<double, double> Static) {
+            std::cout << Name << " | ";
+            for (auto [NsPerElement, Result] : { Virtual, Block, Static })
+            {
+                if (NsPerElement < 0) std::cout << "       n/a | ";
+                else std::cout << std::setw(7) << std::setprecision(3) << NsPerElement << " ns | ";
+            }
+            std::cout << "sum " << Static.second / NumRepeats << std::endl;
+        };
+        const std::pair<double, double> None{-1, 0};
+
+        std::cout << "Sum, ns/element         | virtual[i] | virt.block | static     |" << std::endl;
+        Print("Polymorphic::ArrayOfInt",
+              Measure([&] { return Polymorphic::SumByIndex(*Hide(&Array)); }),
+              Measure([&] { return Polymorphic::Sum(*Hide(&Array)); }),
+              Measure([&] { return Sum(Array); }));
+        Print("Polymorphic::ListOfInt ",
+              Measure([&] { return Polymorphic::SumByIndex(*Hide(&List)); }),
+              Measure([&] { return Polymorphic::Sum(*Hide(&List)); }),
+              Measure([&] { return Sum(List); }));
+        Print("DamageArray            ", None, None, Measure([&] { return Sum(Damages); }));
+
+        std::cout << "Multiply, ns/element    | virtual[i] | virt.block | static     |" << std::endl;
+        auto MultiplyByIndex = [] (Polymorphic::ContainerOfInt& Container, int Factor) {
+            for (int i = 0; i < Container.Size(); i++) Container[i] *= Factor;
+            return 0;
+        };
+        Print("Polymorphic::ArrayOfInt",
+              Measure([&] { return MultiplyByIndex(*Hide(&Array), -1); }),
+              Measure([&] { Polymorphic::Multiply(*Hide(&Array), -1); return 0; }),
+              Measure([&] { Multiply(Array, -1); return 0; }));
+        Print("Polymorphic::ListOfInt ",
+              Measure([&] { return MultiplyByIndex(*Hide(&List), -1); }),
+              Measure([&] { Polymorphic::Multiply(*Hide(&List), -1); return 0; }),
+              Measure([&] { Multiply(List, -1); return 0; }));
+        Print("DamageArray            ", None, None, Measure([&] { Multiply(Damages, -1.f); return 0; }));
+    }
+    REGISTER_BENCHMARK(BenchmarkDispatch, "Generic::BenchmarkDispatch", BenchmarkDispatch);
+
+    // 천만 개의 float에 scalar loop와 dispatch된 kernel로 damage를 적용해 비교한다.
+    void BenchmarkDamage()
+    {
+        constexpr size_t NumDamages = 10000000;
+        DamageArray Damages(NumDamages, 1.f);
+        DamageArray Bonus(NumDamages, 0.5f);
+
+        auto Measure = [] (const char* Name, auto&& Function) {
+            const auto Start = std::chrono::steady_clock::now();
+            Function();
+            const std::chrono::duration<double, std::milli> Elapsed = std::chrono::steady_clock::now() - Start;
+            std::cout << Name << ": " << Elapsed.count() << " ms" << std::endl;
+        };
+
+        for (auto Set : { Simd::EInstructionSet::Scalar, Simd::EInstructionSet::Sse41, Simd::EInstructionSet::Avx2 })
+        {
+            const Simd::KernelTable Kernels = Simd::SelectKernels(Set);
+            if (Kernels.Set != Set) continue;
+            std::cout << "[" << Simd::ToString(Set) << "]" << std::endl;
+            Measure("  Scale      ", [&] { Kernels.ScaleFloat(Damages.data(), Damages.size(), 1.0001f); });
+            Measure("  MultiplyAdd", [&] { Kernels.MultiplyAddFloat(Damages.data(), Bonus.data(), Damages.size(), 2.f); });
+            float Total = 0.f;
+            Measure("  Sum        ", [&] { Total = Kernels.SumFloat(Damages.data(), Damages.size()); });
+            std::cout << "  Total " << Total << std::endl;
+        }
+        std::cout << "Generic::Multiply dispatches to " << Simd::ToString(Simd::Kernels().Set) << std::endl;
+        Measure("Generic::Multiply", [&] { Multiply(Damages, 0.5f); });
+    }
+    REGISTER_BENCHMARK(BenchmarkDamage, "Generic::BenchmarkDamage", BenchmarkDamage);
+
+    // 수천만 개의 float에 대해 한 thread와 thread pool을 비교하고, 병렬 합이 매번 같은지 확인한다.
+    void BenchmarkParallel()
+    {
+        constexpr size_t NumDamages = 20000000;
+        DamageArray Damages(NumDamages);
+        for (size_t i = 0; i < NumDamages; i++) Damages[i] = 1.f / static_cast<float>(i % 1000 + 1);
+        Parallel::ThreadPool& Pool = Parallel::ThreadPool::Shared();
+        std::cout << "Workers: " << Pool.WorkerCount() << " (+ caller)" << std::endl;
+
+        auto Measure = [] (const char* Name, auto&& Function) {
+            const auto Start = std::chrono::steady_clock::now();
+            Function();
+            const std::chrono::duration<double, std::milli> Elapsed = std::chrono::steady_clock::now() - Start;
+            std::cout << Name << ": " << Elapsed.count() << " ms" << std::endl;
+        };
+
+        Measure("Multiply        ", [&] { Multiply(Damages, 1.5f); });
+        Measure("ParallelMultiply", [&] { ParallelMultiply(Damages, 1.f / 1.5f); });
+        float Serial = 0.f, Parallel = 0.f;
+        Measure("Sum             ", [&] { Serial = Sum(Damages); });
+        Measure("ParallelSum     ", [&] { Parallel = ParallelSum(Damages); });
+        std::cout << std::setprecision(9) << "Sum " << Serial << ", ParallelSum " << Parallel << std::endl;
+
+        bool bReproducible = true;
+        for (int i = 0; i < 10; i++) bReproducible = bReproducible && ParallelSum(Damages) == Parallel;
+        std::cout << "ParallelSum reproducible: " << std::boolalpha << bReproducible << std::endl;
+    }
+    REGISTER_BENCHMARK(BenchmarkParallel, "Generic::BenchmarkParallel", BenchmarkParallel);
+}
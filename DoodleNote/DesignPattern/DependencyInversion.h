@@ -26,6 +26,18 @@
 
 #include <vector>
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <tuple>
+#include <cassert>
+#include <concepts>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include "../Implementations/Registry.h"
+#include "../Implementations/Tracing.h"
 
 using namespace std;
 
@@ -41,9 +53,37 @@ struct Person
 	string Name;
 };
 
+struct PersonVisitor
+{
+	virtual void Visit(const Person& InPerson) = 0;
+};
+
 struct RelationshipBrowser
 {
-	virtual vector<Person> FindAllChildrenOf(const Person& InPerson) const = 0;
+	// 결과를 vector<Person>으로 복사하지 않고, 찾는 즉시 Visitor에 넘긴다.
+	// 결과를 한 번 보고 버리는 consumer는 할당 비용이 없다.
+	virtual void VisitAllChildrenOf(const Person& InPerson, PersonVisitor& Visitor) const = 0;
+
+	template<class Func> requires invocable<Func&, const Person&>
+	void ForEachChildOf(const Person& InPerson, Func&& Function) const
+	{
+		struct FunctionVisitor : PersonVisitor
+		{
+			Func& Function;
+			FunctionVisitor(Func& InFunction) : Function(InFunction) {}
+			virtual void Visit(const Person& InPerson) override { Function(InPerson); }
+		} Visitor {Function};
+		VisitAllChildrenOf(InPerson, Visitor);
+	}
+
+	// a convenience wrapper.
+	virtual vector<Person> FindAllChildrenOf(const Person& InPerson) const
+	{
+		TRACE_ZONE("RelationshipBrowser::FindAllChildrenOf");
+		vector<Person> Result;
+		ForEachChildOf(InPerson, [&] (const Person& Child) { Result.push_back(Child); });
+		return Result;
+	}
 };
 
 // a low-level module
@@ -58,14 +98,194 @@ struct Relations : RelationshipBrowser
 		Relations.push_back(RelationType{Child, ERelationship::Child, Parent});
 	}
 
-	virtual vector<Person> FindAllChildrenOf(const Person& InPerson) const override
+	virtual void VisitAllChildrenOf(const Person& InPerson, PersonVisitor& Visitor) const override
 	{
-		vector<Person> Result;
+		TRACE_ZONE("Relations::VisitAllChildrenOf");
+		TRACE_COUNTER("Relations::Size", Relations.size());
 		for (auto&& [Parent,Relation,Child] : Relations)
-			if (Parent.Name == InPerson.Name)
-				Result.push_back(Child);
-		return Result;
+			if (Relation == ERelationship::Parent && Parent.Name == InPerson.Name)
+				Visitor.Visit(Child);
+	}
+};
+
+// a low-level module which many threads can read while another thread is adding.
+// Relations::push_back가 재할당하면 동시에 순회 중인 reader가 해제된 메모리를 읽는다.
+// 여기서는 relation을 고정 크기 segment에 append만 하고, 다 쓴 뒤에 개수를 publish한다.
+// reader는 publish된 개수를 snapshot으로 잡고 그 범위만 읽으므로 lock이 필요없다.
+// 이미 publish된 slot은 절대 변경/해제되지 않으므로(append-only) 별도의 epoch 회수도 필요없다.
+struct ConcurrentRelations : RelationshipBrowser
+{
+	using RelationType = tuple<Person, ERelationship, Person>;
+	static constexpr size_t SegmentSize = 1024;
+
+	struct Segment
+	{
+		RelationType Slots[SegmentSize];
+		atomic<Segment*> Next {nullptr};
+	};
+
+	// a consistent view of the first Count relations.
+	struct Snapshot
+	{
+		const Segment* Head;
+		size_t Count;
+
+		template<class Func>
+		void ForEach(Func&& Visit) const
+		{
+			const Segment* Current = Head;
+			for (size_t i = 0; i < Count; i++)
+			{
+				if (i != 0 && i % SegmentSize == 0)
+					Current = Current->Next.load(memory_order_acquire);
+				Visit(Current->Slots[i % SegmentSize]);
+			}
+		}
+	};
+
+	ConcurrentRelations() : Head(new Segment), Tail(Head) {}
+	ConcurrentRelations(const ConcurrentRelations&) = delete;
+	ConcurrentRelations& operator=(const ConcurrentRelations&) = delete;
+	~ConcurrentRelations()
+	{
+		while (Head)
+		{
+			Segment* Temp = Head;
+			Head = Head->Next.load(memory_order_relaxed);
+			delete Temp;
+		}
+	}
+
+	// writers are serialized among themselves, but never block readers.
+	void AddParentAndChild(Person Parent, Person Child)
+	{
+		lock_guard<mutex> Lock(WriteMutex);
+		const size_t Count = Published.load(memory_order_relaxed);
+		Slot(Count)     = RelationType{Parent, ERelationship::Parent, Child};
+		Slot(Count + 1) = RelationType{Child, ERelationship::Child, Parent};
+		// 두 relation을 한 번에 publish하므로 reader는 한쪽만 추가된 상태를 볼 수 없다.
+		Published.store(Count + 2, memory_order_release);
+	}
+
+	Snapshot GetSnapshot() const
+	{
+		return Snapshot{Head, Published.load(memory_order_acquire)};
+	}
+
+	size_t Size() const { return Published.load(memory_order_acquire); }
+
+	virtual void VisitAllChildrenOf(const Person& InPerson, PersonVisitor& Visitor) const override
+	{
+		GetSnapshot().ForEach([&] (const RelationType& InRelation) {
+			auto&& [Parent,Relation,Child] = InRelation;
+			if (Relation == ERelationship::Parent && Parent.Name == InPerson.Name)
+				Visitor.Visit(Child);
+		});
+	}
+
+private:
+	// only called by the writer. slots at or after Published are invisible to readers.
+	RelationType& Slot(size_t Index)
+	{
+		if (Index != 0 && Index % SegmentSize == 0)
+		{
+			Segment* NewSegment = new Segment;
+			Tail->Next.store(NewSegment, memory_order_release);
+			Tail = NewSegment;
+		}
+		return Tail->Slots[Index % SegmentSize];
+	}
+
+	Segment* Head;
+	Segment* Tail;
+	atomic<size_t> Published {0};
+	mutex WriteMutex;
+};
+
+// a decorator which memoizes the results of another low-level module.
+// Relations를 직접 수정하면 cache가 알 수 없으므로, 쓰기는 반드시 decorator를 거쳐야 한다.
+// 가장 오래 사용하지 않은 결과부터 버린다(LRU). thread-safe하지 않다.
+// 결과는 shared_ptr로 들고 있어서, 방문 중에 visitor가 다른 사람을 조회해 이 결과가 버려져도
+// 방문하던 목록은 방문이 끝날 때까지 살아 있다.
+template<class StoreType>
+struct CachingRelationshipBrowser : RelationshipBrowser
+{
+	struct Stats
+	{
+		size_t Hits = 0;
+		size_t Misses = 0;
+		size_t Evictions = 0;
+		size_t Invalidations = 0;
+	};
+
+	CachingRelationshipBrowser(StoreType& InStore, size_t InCapacity) : Store(InStore), Capacity(InCapacity)
+	{
+		assert(Capacity > 0);
+	}
+
+	void AddParentAndChild(Person Parent, Person Child)
+	{
+		// Parent의 자식 목록만 바뀐다. Child의 자식 목록은 그대로이므로 무효화하지 않는다.
+		Invalidate(Parent);
+		Store.AddParentAndChild(move(Parent), move(Child));
+	}
+
+	void Invalidate(const Person& InPerson)
+	{
+		auto Found = Index.find(InPerson.Name);
+		if (Found == Index.end()) return;
+		Entries.erase(Found->second);
+		Index.erase(Found);
+		CacheStats.Invalidations++;
 	}
+
+	const Stats& GetStats() const { return CacheStats; }
+	size_t Size() const { return Entries.size(); }
+
+	virtual void VisitAllChildrenOf(const Person& InPerson, PersonVisitor& Visitor) const override
+	{
+		const shared_ptr<const vector<Person>> Pinned = Lookup(InPerson);
+		for (auto&& Child : *Pinned)
+			Visitor.Visit(Child);
+	}
+
+	virtual vector<Person> FindAllChildrenOf(const Person& InPerson) const override
+	{
+		return *Lookup(InPerson);
+	}
+
+private:
+	using EntryType = pair<string, shared_ptr<const vector<Person>>>;
+
+	shared_ptr<const vector<Person>> Lookup(const Person& InPerson) const
+	{
+		auto Found = Index.find(InPerson.Name);
+		if (Found != Index.end())
+		{
+			CacheStats.Hits++;
+			Entries.splice(Entries.begin(), Entries, Found->second);
+			return Found->second->second;
+		}
+
+		CacheStats.Misses++;
+		if (Entries.size() >= Capacity)
+		{
+			Index.erase(Entries.back().first);
+			Entries.pop_back();
+			CacheStats.Evictions++;
+		}
+		Entries.emplace_front(InPerson.Name, make_shared<const vector<Person>>(Store.FindAllChildrenOf(InPerson)));
+		Index.emplace(InPerson.Name, Entries.begin());
+		return Entries.front().second;
+	}
+
+	StoreType& Store;
+	const size_t Capacity;
+
+	// front가 가장 최근에 사용한 결과이다.
+	mutable list<EntryType> Entries;
+	mutable unordered_map<string, typename list<EntryType>::iterator> Index;
+	mutable Stats CacheStats;
 };
 
 // a high-level module
@@ -87,14 +307,13 @@ struct Reserch
 	void ReserchBy(const RelationshipBrowser& Browser)
 	{
 		Person Parent {"John"};
-		for (auto&& Child : Browser.FindAllChildrenOf(Parent))
-		{
+		Browser.ForEachChildOf(Parent, [&] (const Person& Child) {
 			cout << Parent.Name << " has a child called " << Child.Name << endl;
-		}
+		});
 	}
 };
 
-void Test()
+void TestDependencyInversion()
 {
 	Relations relations;
 	relations.AddParentAndChild(Person{"John"},Person{"James"});
@@ -104,4 +323,120 @@ void Test()
 
 	Reserch r;
 	r.ReserchBy(relations);
-}
\ No newline at end of file
+}
+REGISTER_TEST(TestDependencyInversion, "DependencyInversion::Test", TestDependencyInversion);
+
+// 하나의 writer가 relation을 추가하는 동안 여러 reader가 snapshot을 읽는다.
+// P{i % NumParents}는 C{i}의 부모이므로, reader가 본 모든 edge는 이 규칙을 만족해야 한다.
+void TestConcurrentRelations()
+{
+	constexpr int NumPairs = 200000;
+	constexpr int NumParents = 100;
+	constexpr int NumReaders = 4;
+
+	ConcurrentRelations relations;
+	atomic<bool> bDone {false};
+	atomic<long long> TornEdges {0};
+	atomic<long long> SnapshotsRead {0};
+
+	auto IndexOf = [] (const string& Name) { return stoi(Name.substr(1)); };
+
+	auto Reader = [&] (int ReaderIndex) {
+		size_t LastCount = 0;
+		size_t LastChildren = 0;
+		const Person Parent {"P" + to_string(ReaderIndex % NumParents)};
+		while (!bDone.load(memory_order_acquire))
+		{
+			auto Snapshot = relations.GetSnapshot();
+			if (Snapshot.Count < LastCount || Snapshot.Count % 2 != 0) TornEdges++;
+			LastCount = Snapshot.Count;
+
+			// 짝수 slot은 Parent edge, 바로 다음 slot은 그 역방향 Child edge이다.
+			const ConcurrentRelations::RelationType* Previous = nullptr;
+			size_t Index = 0;
+			Snapshot.ForEach([&] (const ConcurrentRelations::RelationType& InRelation) {
+				auto&& [From,Relation,To] = InRelation;
+				if (Index++ % 2 == 0)
+				{
+					if (Relation != ERelationship::Parent || IndexOf(To.Name) % NumParents != IndexOf(From.Name))
+						TornEdges++;
+					Previous = &InRelation;
+				}
+				else
+				{
+					auto&& [PrevFrom,PrevRelation,PrevTo] = *Previous;
+					if (Relation != ERelationship::Child || From.Name != PrevTo.Name || To.Name != PrevFrom.Name)
+						TornEdges++;
+				}
+			});
+
+			auto Children = relations.FindAllChildrenOf(Parent);
+			if (Children.size() < LastChildren) TornEdges++;
+			LastChildren = Children.size();
+			for (auto&& Child : Children)
+				if (IndexOf(Child.Name) % NumParents != IndexOf(Parent.Name))
+					TornEdges++;
+
+			SnapshotsRead++;
+		}
+	};
+
+	vector<thread> Readers;
+	for (int i = 0; i < NumReaders; i++)
+		Readers.emplace_back(Reader, i);
+
+	for (int i = 0; i < NumPairs; i++)
+		relations.AddParentAndChild(Person{"P" + to_string(i % NumParents)}, Person{"C" + to_string(i)});
+
+	bDone.store(true, memory_order_release);
+	for (auto& ReaderThread : Readers) ReaderThread.join();
+
+	cout << "relations: " << relations.Size()
+		 << ", snapshots read: " << SnapshotsRead
+		 << ", torn edges: " << TornEdges << endl;
+	CHECK(relations.Size() == 2 * NumPairs);
+	CHECK(TornEdges == 0);
+}
+REGISTER_TEST(TestConcurrentRelations, "DependencyInversion::TestConcurrentRelations", TestConcurrentRelations);
+
+void TestCachingRelationshipBrowser()
+{
+	Relations relations;
+	CachingRelationshipBrowser<Relations> Cache(relations, 2);
+	Cache.AddParentAndChild(Person{"John"},Person{"James"});
+	Cache.AddParentAndChild(Person{"John"},Person{"Kim"});
+	Cache.AddParentAndChild(Person{"Mon"}, Person{"Su"});
+
+	Reserch r;
+	r.ReserchBy(Cache); // miss
+	r.ReserchBy(Cache); // hit
+
+	// John을 건드리지 않으므로 John의 결과는 유지된다.
+	Cache.AddParentAndChild(Person{"Mon"}, Person{"Yu"});
+	r.ReserchBy(Cache); // hit
+
+	// John의 자식이 바뀌었으므로 John의 결과만 무효화된다.
+	Cache.AddParentAndChild(Person{"John"},Person{"Lee"});
+	r.ReserchBy(Cache); // miss
+
+	Cache.FindAllChildrenOf(Person{"Mon"});   // miss
+	Cache.FindAllChildrenOf(Person{"James"}); // miss, evicts John
+
+	auto&& Stats = Cache.GetStats();
+	cout << "hits: " << Stats.Hits
+		 << ", misses: " << Stats.Misses
+		 << ", evictions: " << Stats.Evictions
+		 << ", invalidations: " << Stats.Invalidations << endl;
+	CHECK(Stats.Hits == 2 && Stats.Misses == 4 && Stats.Evictions == 1 && Stats.Invalidations == 1);
+
+	// 방문 중에 다른 사람을 조회해서 방문하던 결과가 버려져도 끝까지 방문한다.
+	CachingRelationshipBrowser<Relations> Small(relations, 1);
+	vector<string> Visited;
+	Small.ForEachChildOf(Person{"John"}, [&] (const Person& Child) {
+		Small.FindAllChildrenOf(Person{"Mon"});
+		Visited.push_back(Child.Name);
+	});
+	CHECK((Visited == vector<string>{"James", "Kim", "Lee"}));
+	CHECK(Small.GetStats().Evictions >= 1);
+}
+REGISTER_TEST(TestCachingRelationshipBrowser, "DependencyInversion::TestCachingRelationshipBrowser", TestCachingRelationshipBrowser);
\ No newline at end of file
@@ -6,6 +6,21 @@
 // about the methods that are of interest to them.
 // 사용하지 않는 메서드를 강요하면 안된다. 인터페이스들을 쪼개야 한다.
 
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Implementations/BoundedQueue.h"
+#include "../Implementations/Registry.h"
+
 namespace Problematic_Case_ISP
 {
 	struct Document;
@@ -31,16 +46,34 @@ namespace Problematic_Case_ISP
 
 namespace Case_ISP_Applied
 {
-	struct Document;
+	struct Document
+	{
+		int Id = 0;
+		std::string Content;
+		bool bScanned = false;
+		bool bPrinted = false;
+	};
 
+	// Batch 함수는 기본 구현이 있으므로 구현하는 쪽에 강요하지 않는다.
+	// 한 번의 호출에 고정 비용이 드는 장치는 override해서 여러 문서를 한꺼번에 처리한다.
 	struct IPrinter
 	{
+		virtual ~IPrinter() = default;
 		virtual void Print(Document& Doc) = 0;
+		virtual void PrintBatch(std::span<Document* const> Docs)
+		{
+			for (Document* Doc : Docs) Print(*Doc);
+		}
 	};
 
 	struct IScanner
 	{
+		virtual ~IScanner() = default;
 		virtual void Scan(Document& Doc) = 0;
+		virtual void ScanBatch(std::span<Document* const> Docs)
+		{
+			for (Document* Doc : Docs) Scan(*Doc);
+		}
 	};
 
 	struct IFaxer
@@ -64,6 +97,207 @@ namespace Case_ISP_Applied
 		virtual void Scan(Document& Doc) override;
 	};
 
+	struct PipelineOptions
+	{
+		size_t QueueCapacity = 256;  // 2의 거듭제곱
+		size_t BatchSize = 16;       // 한 번의 ScanBatch/PrintBatch에 넘기는 최대 문서 수
+		int NumScanWorkers = 1;
+		int NumPrintWorkers = 1;
+	};
+
+	// Scan과 Print를 따로 도는 stage로 나누고 bounded lock-free queue로 잇는다.
+	//   Submit -> [Input queue] -> Scan workers -> [Print queue] -> Print workers
+	// worker는 queue에서 BatchSize개까지 모아서 한 번에 처리한다.
+	// queue가 가득 차면 앞 stage(그리고 Submit)가 기다리므로 처리량보다 빨리 쌓이지 않는다.
+	// 문서는 호출한 쪽이 소유하며 Drain이 돌아올 때까지 살아 있어야 한다.
+	// worker가 여러 개면 Print되는 순서가 Submit 순서와 다를 수 있다.
+	// ScanBatch/PrintBatch가 던진 예외는 그 batch를 실패로 세고 처음 것만 보관했다가 Drain이 다시 던진다.
+	// 소멸자는 보관한 예외를 던지지 않는다.
+	class DocumentPipeline
+	{
+	public:
+		struct Stats
+		{
+			size_t Completed = 0;
+			size_t Failed = 0;
+			size_t ScanBatches = 0;
+			size_t PrintBatches = 0;
+		};
+
+		// Options가 잘못되었으면 std::invalid_argument를 던진다.
+		DocumentPipeline(IScanner& InScanner, IPrinter& InPrinter, const PipelineOptions& InOptions = {})
+			: Scanner(InScanner), Printer(InPrinter), Options(Validate(InOptions)),
+			  InputQueue(InOptions.QueueCapacity), PrintQueue(InOptions.QueueCapacity)
+		{
+			try
+			{
+				for (int i = 0; i < Options.NumScanWorkers; i++) ScanWorkers.emplace_back([this] { ScanLoop(); });
+				for (int i = 0; i < Options.NumPrintWorkers; i++) PrintWorkers.emplace_back([this] { PrintLoop(); });
+			}
+			catch (...)
+			{
+				// 이미 시작한 worker는 빈 queue를 보고 곧 끝난다.
+				Stop();
+				throw;
+			}
+		}
+
+		DocumentPipeline(const DocumentPipeline&) = delete;
+		DocumentPipeline& operator=(const DocumentPipeline&) = delete;
+
+		~DocumentPipeline() { Stop(); }
+
+		// Input queue가 가득 차 있으면 자리가 날 때까지 기다린다.
+		void Submit(Document& Doc)
+		{
+			Submitted.fetch_add(1, std::memory_order_relaxed);
+			Push(InputQueue, &Doc);
+		}
+
+		// 지금까지 Submit한 문서가 모두 Print되거나 실패할 때까지 기다린다.
+		// 그 사이 worker가 예외를 받았다면 처음 받은 예외를 다시 던진다.
+		void Drain()
+		{
+			Parallel::Backoff Wait;
+			while (Completed.load(std::memory_order_acquire) + Failed.load(std::memory_order_acquire)
+				!= Submitted.load(std::memory_order_relaxed))
+				Wait.Wait();
+
+			std::exception_ptr FirstError;
+			{
+				std::lock_guard Lock(ErrorMutex);
+				std::swap(FirstError, Error);
+			}
+			if (FirstError) std::rethrow_exception(FirstError);
+		}
+
+		Stats GetStats() const
+		{
+			return {Completed.load(), Failed.load(), ScanBatches.load(), PrintBatches.load()};
+		}
+
+	private:
+		using Queue = Parallel::BoundedQueue<Document*>;
+
+		static const PipelineOptions& Validate(const PipelineOptions& InOptions)
+		{
+			// worker가 없거나 한 번에 하나도 꺼내지 않으면 Drain이 끝나지 않는다.
+			if (InOptions.NumScanWorkers <= 0 || InOptions.NumPrintWorkers <= 0)
+				throw std::invalid_argument("DocumentPipeline needs at least one scan and one print worker");
+			if (InOptions.BatchSize == 0)
+				throw std::invalid_argument("DocumentPipeline BatchSize must be positive");
+			return InOptions;
+		}
+
+		// 남은 문서를 모두 처리한 뒤 stage 순서대로 멈춘다.
+		void Stop()
+		{
+			bInputClosed.store(true, std::memory_order_release);
+			for (auto& Worker : ScanWorkers) Worker.join();
+			bScanFinished.store(true, std::memory_order_release);
+			for (auto& Worker : PrintWorkers) Worker.join();
+		}
+
+		static void Push(Queue& Target, Document* Doc)
+		{
+			Parallel::Backoff Wait;
+			while (!Target.TryPush(Doc)) Wait.Wait();
+		}
+
+		// batch의 문서를 실패로 세고, 처음 받은 예외만 남긴다. catch 안에서 호출한다.
+		void Fail(size_t NumDocuments)
+		{
+			{
+				std::lock_guard Lock(ErrorMutex);
+				if (!Error) Error = std::current_exception();
+			}
+			Failed.fetch_add(NumDocuments, std::memory_order_release);
+		}
+
+		// BatchSize개까지 꺼낸다. 하나도 없으면 0.
+		size_t PopBatch(Queue& Source, std::vector<Document*>& Batch)
+		{
+			Batch.clear();
+			Document* Doc;
+			while (Batch.size() < Options.BatchSize && Source.TryPop(Doc)) Batch.push_back(Doc);
+			return Batch.size();
+		}
+
+		void ScanLoop()
+		{
+			std::vector<Document*> Batch;
+			Parallel::Backoff Wait;
+			while (true)
+			{
+				// 닫힌 것을 먼저 확인해야 마지막 문서를 놓치지 않는다.
+				const bool bClosed = bInputClosed.load(std::memory_order_acquire);
+				if (PopBatch(InputQueue, Batch) == 0)
+				{
+					if (bClosed) return;
+					Wait.Wait();
+					continue;
+				}
+				Wait.Reset();
+				ScanBatches.fetch_add(1, std::memory_order_relaxed);
+				try
+				{
+					Scanner.ScanBatch(Batch);
+				}
+				catch (...)
+				{
+					Fail(Batch.size());
+					continue;
+				}
+				for (Document* Doc : Batch) Push(PrintQueue, Doc);
+			}
+		}
+
+		void PrintLoop()
+		{
+			std::vector<Document*> Batch;
+			Parallel::Backoff Wait;
+			while (true)
+			{
+				const bool bClosed = bScanFinished.load(std::memory_order_acquire);
+				if (PopBatch(PrintQueue, Batch) == 0)
+				{
+					if (bClosed) return;
+					Wait.Wait();
+					continue;
+				}
+				Wait.Reset();
+				PrintBatches.fetch_add(1, std::memory_order_relaxed);
+				try
+				{
+					Printer.PrintBatch(Batch);
+				}
+				catch (...)
+				{
+					Fail(Batch.size());
+					continue;
+				}
+				Completed.fetch_add(Batch.size(), std::memory_order_release);
+			}
+		}
+
+		IScanner& Scanner;
+		IPrinter& Printer;
+		const PipelineOptions Options;
+		Queue InputQueue;
+		Queue PrintQueue;
+		std::vector<std::thread> ScanWorkers;
+		std::vector<std::thread> PrintWorkers;
+		std::atomic<bool> bInputClosed {false};
+		std::atomic<bool> bScanFinished {false};
+		std::atomic<size_t> Submitted {0};
+		std::atomic<size_t> Completed {0};
+		std::atomic<size_t> Failed {0};
+		std::atomic<size_t> ScanBatches {0};
+		std::atomic<size_t> PrintBatches {0};
+		std::mutex ErrorMutex;
+		std::exception_ptr Error;
+	};
+
 	struct Machine: IMachine
 	{
 		IPrinter& Printer;
@@ -80,5 +314,212 @@ namespace Case_ISP_Applied
 		{
 			Scanner.Scan(Doc);
 		}
+
+		// Scan한 뒤 Print하는 작업을 pipeline으로 처리한다.
+		void StartPipeline(const PipelineOptions& Options = {})
+		{
+			Pipeline = std::make_unique<DocumentPipeline>(Scanner, Printer, Options);
+		}
+
+		// StartPipeline하지 않았거나 StopPipeline한 뒤에 호출하면 std::logic_error를 던진다.
+		void Submit(Document& Doc)
+		{
+			if (!Pipeline) throw std::logic_error("Machine::Submit called without a running pipeline");
+			Pipeline->Submit(Doc);
+		}
+
+		// worker가 받은 예외가 있으면 다시 던진다.
+		void Drain()
+		{
+			if (Pipeline) Pipeline->Drain();
+		}
+
+		// 남은 문서를 모두 처리하고 worker를 멈춘다.
+		void StopPipeline()
+		{
+			Pipeline.reset();
+		}
+
+	private:
+		std::unique_ptr<DocumentPipeline> Pipeline;
+	};
+
+	// 실제 장치 대신 쓰는 local 장치. 호출마다 고정 지연, 문서마다 추가 지연이 있다.
+	// 지연은 I/O를 기다리는 것처럼 sleep으로 흉내내므로 CPU를 쓰지 않는다.
+	class LocalDevice
+	{
+		std::chrono::microseconds PerCall;
+		std::chrono::microseconds PerDocument;
+	protected:
+		LocalDevice(std::chrono::microseconds InPerCall, std::chrono::microseconds InPerDocument)
+			: PerCall(InPerCall), PerDocument(InPerDocument) {}
+		void Wait(size_t NumDocuments) const
+		{
+			std::this_thread::sleep_for(PerCall + PerDocument * static_cast<long long>(NumDocuments));
+		}
+	};
+
+	class LocalScanner: public IScanner, LocalDevice
+	{
+	public:
+		LocalScanner(std::chrono::microseconds InPerCall, std::chrono::microseconds InPerDocument) : LocalDevice(InPerCall, InPerDocument) {}
+		virtual void Scan(Document& Doc) override
+		{
+			Wait(1);
+			Doc.bScanned = true;
+		}
+		virtual void ScanBatch(std::span<Document* const> Docs) override
+		{
+			Wait(Docs.size());
+			for (Document* Doc : Docs) Doc->bScanned = true;
+		}
 	};
+
+	class LocalPrinter: public IPrinter, LocalDevice
+	{
+	public:
+		LocalPrinter(std::chrono::microseconds InPerCall, std::chrono::microseconds InPerDocument) : LocalDevice(InPerCall, InPerDocument) {}
+		virtual void Print(Document& Doc) override
+		{
+			Wait(1);
+			assert(Doc.bScanned);
+			Doc.bPrinted = true;
+		}
+		virtual void PrintBatch(std::span<Document* const> Docs) override
+		{
+			Wait(Docs.size());
+			for (Document* Doc : Docs)
+			{
+				assert(Doc->bScanned);
+				Doc->bPrinted = true;
+			}
+		}
+	};
+
+	// 같은 local 장치로 동기 Machine과 pipeline의 처리량을 비교한다.
+	inline void BenchmarkPipeline()
+	{
+		using namespace std::chrono;
+		constexpr int NumDocuments = 2000;
+		LocalScanner Scanner(microseconds(200), microseconds(20));
+		LocalPrinter Printer(microseconds(300), microseconds(30));
+		Machine Device(Printer, Scanner);
+
+		auto Run = [&] (const char* Name, auto&& Process) {
+			std::vector<Document> Docs(NumDocuments);
+			for (int i = 0; i < NumDocuments; i++) Docs[i].Id = i;
+			const auto Start = steady_clock::now();
+			Process(Docs);
+			const double Seconds = duration<double>(steady_clock::now() - Start).count();
+			for (auto& Doc : Docs) CHECK(Doc.bPrinted);
+			std::cout << Name << ": " << NumDocuments / Seconds << " documents/s" << std::endl;
+		};
+
+		Run("synchronous         ", [&] (std::vector<Document>& Docs) {
+			for (auto& Doc : Docs)
+			{
+				Device.Scan(Doc);
+				Device.Print(Doc);
+			}
+		});
+		for (size_t BatchSize : {1, 16})
+		{
+			PipelineOptions Options;
+			Options.BatchSize = BatchSize;
+			Run(BatchSize == 1 ? "pipeline, batch 1   " : "pipeline, batch 16  ", [&] (std::vector<Document>& Docs) {
+				Device.StartPipeline(Options);
+				for (auto& Doc : Docs) Device.Submit(Doc);
+				Device.Drain();
+				Device.StopPipeline();
+			});
+		}
+	}
+	REGISTER_BENCHMARK(BenchmarkPipeline, "Case_ISP_Applied::BenchmarkPipeline", BenchmarkPipeline);
+
+	inline void TestPipelineOptions()
+	{
+		LocalScanner Scanner(std::chrono::microseconds(0), std::chrono::microseconds(0));
+		LocalPrinter Printer(std::chrono::microseconds(0), std::chrono::microseconds(0));
+		auto Rejects = [&] (auto&& Change) {
+			PipelineOptions Options;
+			Change(Options);
+			try { DocumentPipeline Pipeline(Scanner, Printer, Options); } catch (const std::invalid_argument&) { return true; }
+			return false;
+		};
+		CHECK(Rejects([] (PipelineOptions& Options) { Options.NumScanWorkers = 0; }));
+		CHECK(Rejects([] (PipelineOptions& Options) { Options.NumPrintWorkers = -1; }));
+		CHECK(Rejects([] (PipelineOptions& Options) { Options.BatchSize = 0; }));
+		CHECK(Rejects([] (PipelineOptions& Options) { Options.QueueCapacity = 100; }));
+		CHECK(!Rejects([] (PipelineOptions&) {}));
+	}
+	REGISTER_TEST(TestPipelineOptions, "Case_ISP_Applied::TestPipelineOptions", TestPipelineOptions);
+
+	// queue보다 훨씬 많은 문서를 여러 worker로 처리해도 모든 문서가 Scan과 Print를 한 번씩 거친다.
+	inline void TestPipeline()
+	{
+		constexpr int NumDocuments = 1000;
+		LocalScanner Scanner(std::chrono::microseconds(0), std::chrono::microseconds(0));
+		LocalPrinter Printer(std::chrono::microseconds(0), std::chrono::microseconds(0));
+
+		PipelineOptions Options;
+		Options.QueueCapacity = 2;
+		Options.BatchSize = 3;
+		Options.NumScanWorkers = 3;
+		Options.NumPrintWorkers = 2;
+
+		std::vector<Document> Docs(NumDocuments);
+		for (int i = 0; i < NumDocuments; i++) Docs[i].Id = i;
+		DocumentPipeline Pipeline(Scanner, Printer, Options);
+		for (auto& Doc : Docs) Pipeline.Submit(Doc);
+		Pipeline.Drain();
+
+		for (const auto& Doc : Docs) CHECK(Doc.bScanned && Doc.bPrinted);
+		const DocumentPipeline::Stats Stats = Pipeline.GetStats();
+		CHECK(Stats.Completed == NumDocuments && Stats.Failed == 0);
+		CHECK(Stats.ScanBatches >= (NumDocuments + Options.BatchSize - 1) / Options.BatchSize);
+		CHECK(Stats.PrintBatches >= (NumDocuments + Options.BatchSize - 1) / Options.BatchSize);
+	}
+	REGISTER_TEST(TestPipeline, "Case_ISP_Applied::TestPipeline", TestPipeline);
+
+	// 장치가 던진 예외는 worker를 멈추지 않고 Drain에서 호출한 쪽으로 돌아온다.
+	inline void TestPipelineErrors()
+	{
+		struct JammedScanner: IScanner
+		{
+			virtual void Scan(Document& Doc) override
+			{
+				if (Doc.Id == 7) throw std::runtime_error("paper jam");
+				Doc.bScanned = true;
+			}
+		};
+		constexpr int NumDocuments = 20;
+		JammedScanner Scanner;
+		LocalPrinter Printer(std::chrono::microseconds(0), std::chrono::microseconds(0));
+		Machine Device(Printer, Scanner);
+
+		Document Orphan;
+		bool bRejected = false;
+		try { Device.Submit(Orphan); } catch (const std::logic_error&) { bRejected = true; }
+		CHECK(bRejected);
+
+		PipelineOptions Options;
+		Options.BatchSize = 3;
+		std::vector<Document> Docs(NumDocuments);
+		for (int i = 0; i < NumDocuments; i++) Docs[i].Id = i;
+		Device.StartPipeline(Options);
+		for (auto& Doc : Docs) Device.Submit(Doc);
+		bool bJammed = false;
+		try { Device.Drain(); } catch (const std::runtime_error&) { bJammed = true; }
+		CHECK(bJammed);
+		CHECK(!Docs[7].bPrinted);
+
+		// 예외는 한 번만 전달되고, 그 뒤의 문서는 평소대로 처리된다.
+		Document Last;
+		Last.Id = NumDocuments;
+		Device.Submit(Last);
+		Device.Drain();
+		CHECK(Last.bPrinted);
+		Device.StopPipeline();
+	}
+	REGISTER_TEST(TestPipelineErrors, "Case_ISP_Applied::TestPipelineErrors", TestPipelineErrors);
 }
\ No newline at end of file
@@ -14,6 +14,13 @@
 
 #include <vector>
 #include <iostream>
+#include <chrono>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include "../Implementations/SimdKernels.h"
+#include "../Implementations/Registry.h"
 
 using namespace std;
 
@@ -63,6 +70,7 @@ namespace Problematic_Case_In_LSP
 		Square s{5};
 		Process(s);
 	}
+	REGISTER_TEST(Test, "Problematic_Case_In_LSP::Test", Test);
 	// Area: 50
 	// Expected: 50
 	// Area: 100
@@ -75,4 +83,200 @@ namespace Problematic_Case_In_LSP
 		static Square	 CreateSquare(int size) { return Square(size);}
 	};
 	// But, It does not solve the problem fundamentally.
-}
\ No newline at end of file
+}
+
+// 수백만 개의 도형의 넓이를 매 frame 계산할 때 사용한다.
+// 객체마다 virtual setter를 거치는 대신 너비, 높이, 종류를 각각 연속된 배열(SoA)에 둔다.
+// 정사각형의 invariant(너비 == 높이)는 삽입할 때와 batch 연산 뒤에 store가 지킨다.
+namespace Data_Oriented_Shapes
+{
+	enum class EShapeKind : uint8_t { Rectangle, Square };
+
+	class ShapeStore
+	{
+		vector<int> Widths;
+		vector<int> Heights;
+		vector<EShapeKind> Kinds;
+
+		// 정사각형의 높이를 너비에 맞춘다. 분기 없는 select라서 compiler가 vectorize할 수 있다.
+		void SyncSquareHeights()
+		{
+			const size_t Count = Size();
+			int* H = Heights.data();
+			const int* W = Widths.data();
+			const EShapeKind* K = Kinds.data();
+			for (size_t i = 0; i < Count; i++) H[i] = K[i] == EShapeKind::Square ? W[i] : H[i];
+		}
+
+		void SyncSquareWidths()
+		{
+			const size_t Count = Size();
+			int* W = Widths.data();
+			const int* H = Heights.data();
+			const EShapeKind* K = Kinds.data();
+			for (size_t i = 0; i < Count; i++) W[i] = K[i] == EShapeKind::Square ? H[i] : W[i];
+		}
+
+	public:
+		size_t AddRectangle(int w, int h)
+		{
+			Widths.push_back(w);
+			Heights.push_back(h);
+			Kinds.push_back(EShapeKind::Rectangle);
+			return Size() - 1;
+		}
+
+		size_t AddSquare(int size)
+		{
+			Widths.push_back(size);
+			Heights.push_back(size);
+			Kinds.push_back(EShapeKind::Square);
+			return Size() - 1;
+		}
+
+		void Reserve(size_t Count)
+		{
+			Widths.reserve(Count);
+			Heights.reserve(Count);
+			Kinds.reserve(Count);
+		}
+
+		size_t Size() const { return Kinds.size(); }
+		EShapeKind GetKind(size_t i) const { return Kinds[i]; }
+		int GetWidth(size_t i) const { return Widths[i]; }
+		int GetHeight(size_t i) const { return Heights[i]; }
+		// ComputeAreas(Simd::Product)와 같은 값이 나오도록 signed overflow 대신 wrap-around로 곱한다.
+		int Area(size_t i) const { return static_cast<int>(static_cast<uint32_t>(Widths[i]) * static_cast<uint32_t>(Heights[i])); }
+
+		// Square::SetWidth/SetHeight와 같은 의미다.
+		void SetWidth(size_t i, int w)
+		{
+			Widths[i] = w;
+			if (Kinds[i] == EShapeKind::Square) Heights[i] = w;
+		}
+		void SetHeight(size_t i, int h)
+		{
+			Heights[i] = h;
+			if (Kinds[i] == EShapeKind::Square) Widths[i] = h;
+		}
+
+		// Out[i] = Area(i)
+		void ComputeAreas(span<int> Out) const
+		{
+			assert(Out.size() == Size());
+			Simd::Product(Out.data(), Widths.data(), Heights.data(), Size());
+		}
+
+		long long TotalArea() const
+		{
+			constexpr size_t BatchSize = 4096;
+			int Batch[BatchSize];
+			long long Total = 0;
+			for (size_t Begin = 0; Begin < Size(); Begin += BatchSize)
+			{
+				const size_t Count = min(BatchSize, Size() - Begin);
+				Simd::Product(Batch, Widths.data() + Begin, Heights.data() + Begin, Count);
+				for (size_t i = 0; i < Count; i++) Total += Batch[i];
+			}
+			return Total;
+		}
+
+		// 모든 도형의 너비에 Factor를 곱한다. 정사각형은 높이도 같이 바뀐다.
+		void ScaleWidths(int Factor)
+		{
+			Simd::Scale(Widths.data(), Size(), Factor);
+			SyncSquareHeights();
+		}
+
+		void ScaleHeights(int Factor)
+		{
+			Simd::Scale(Heights.data(), Size(), Factor);
+			SyncSquareWidths();
+		}
+
+		// 너비와 높이를 같은 비율로 바꾸므로 정사각형은 그대로 정사각형이다.
+		void Scale(int Factor)
+		{
+			Simd::Scale(Widths.data(), Size(), Factor);
+			Simd::Scale(Heights.data(), Size(), Factor);
+		}
+	};
+
+	void Test()
+	{
+		ShapeStore Store;
+		const size_t r = Store.AddRectangle(5, 5);
+		const size_t s = Store.AddSquare(5);
+
+		// Problematic_Case_In_LSP::Process와 같은 결과가 나온다.
+		Store.SetWidth(r, 10);
+		Store.SetWidth(s, 10);
+		cout << "Rectangle Area: " << Store.Area(r) << endl; // 50
+		cout << "Square Area: " << Store.Area(s) << endl;    // 100
+
+		Store.ScaleHeights(3);
+		CHECK(Store.GetWidth(r) == 10 && Store.GetHeight(r) == 15);
+		CHECK(Store.GetWidth(s) == 30 && Store.GetHeight(s) == 30);
+		cout << "Total Area: " << Store.TotalArea() << endl; // 150 + 900
+
+		// int 범위를 넘는 넓이도 Area와 ComputeAreas가 같은 값을 낸다.
+		const size_t Big = Store.AddRectangle(100000, 100000);
+		vector<int> Areas(Store.Size());
+		Store.ComputeAreas(Areas);
+		CHECK(Store.Area(Big) == Areas[Big]);
+	}
+	REGISTER_TEST(Test, "Data_Oriented_Shapes::Test", Test);
+
+	// 백만 개 단위의 도형에 대해 넓이 합과 너비 변경을 virtual 경로와 비교한다.
+	void Benchmark()
+	{
+		using Problematic_Case_In_LSP::Rectangle;
+		using Problematic_Case_In_LSP::Square;
+		constexpr int NumShapes = 4000000;
+		constexpr int NumFrames = 5;
+
+		vector<unique_ptr<Rectangle>> Objects;
+		ShapeStore Store;
+		Objects.reserve(NumShapes);
+		Store.Reserve(NumShapes);
+		for (int i = 0; i < NumShapes; i++)
+		{
+			const int w = 1 + i % 13;
+			const int h = 1 + i % 7;
+			if (i % 3 == 0)
+			{
+				Objects.push_back(make_unique<Square>(w));
+				Store.AddSquare(w);
+			}
+			else
+			{
+				Objects.push_back(make_unique<Rectangle>(w, h));
+				Store.AddRectangle(w, h);
+			}
+		}
+
+		auto Elapsed = [] (auto Start) {
+			return chrono::duration<double, milli>(chrono::steady_clock::now() - Start).count();
+		};
+
+		double VirtualMs = 0, StoreMs = 0;
+		long long VirtualTotal = 0, StoreTotal = 0;
+		for (int Frame = 0; Frame < NumFrames; Frame++)
+		{
+			const int Factor = Frame % 2 == 0 ? 2 : -2;
+			auto Start = chrono::steady_clock::now();
+			for (auto& Shape : Objects) Shape->SetWidth(Shape->GetWidth() * Factor);
+			for (auto& Shape : Objects) VirtualTotal += Shape->Area();
+			VirtualMs += Elapsed(Start);
+
+			Start = chrono::steady_clock::now();
+			Store.ScaleWidths(Factor);
+			StoreTotal += Store.TotalArea();
+			StoreMs += Elapsed(Start);
+		}
+
+		cout << "virtual objects: " << VirtualMs / NumFrames << " ms per frame (total " << VirtualTotal << ")" << endl;
+		cout << "ShapeStore:      " << StoreMs / NumFrames << " ms per frame (total " << StoreTotal << ")" << endl;
+	}
+	REGISTER_BENCHMARK(Benchmark, "Data_Oriented_Shapes::Benchmark", Benchmark);
+}
@@ -7,6 +7,8 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include "../Implementations/Registry.h"
+#include "../Implementations/Tracing.h"
 
 using namespace std;
 
@@ -114,6 +116,7 @@ namespace Problematic_Case_OCP
 		}
 		cout << endl;
 	}
+	REGISTER_TEST(Test, "Problematic_Case_OCP::Test", Test);
 }
 
 namespace Open_Closed_Case
@@ -179,10 +182,12 @@ namespace Open_Closed_Case
 
 		virtual Items Apply(const Items& InProducts, const Specification<Product>& Spec) override
 		{
+			TRACE_ZONE("ProductFilter::Apply");
 			Items Result;
 			for (Product* InProduct : InProducts)
 				if (Spec.IsSatisfied(InProduct))
 					Result.push_back(InProduct);
+			TRACE_COUNTER("ProductFilter::Apply.Matched", Result.size());
 			return Result;
 		}
 	};
@@ -229,4 +234,5 @@ namespace Open_Closed_Case
 		}
 		cout << endl;
 	}
+	REGISTER_TEST(Test, "Open_Closed_Case::Test", Test);
 }
@@ -12,35 +12,48 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <string_view>
+#include "../Implementations/JournalEntries.h"
+#include "../Implementations/Registry.h"
+#include "../Implementations/Tracing.h"
 
 using namespace std;
 
 struct Journal
 {
     string title;
-    vector<string> entries;
+    JournalEntries entries;
+    int next_id = 1;
 
     explicit Journal(const string& title)
         : title{title}
     {
     }
 
-    void add(const string& entry);
+    void add(string_view entry);
+
+    // id가 이미 정해진 entry를 추가한다. (예: 파일에서 읽어올 때)
+    void append(int id, string_view entry);
 
     // persistence is a separate concern.. This violates the SRP.
     void save(const string& filename);
 };
 
-void Journal::add(const string& entry)
+void Journal::add(string_view entry)
 {
-    static int count = 1;
-    entries.push_back(to_string(count++) + ": " + entry);
+    entries.push_back(next_id++, entry);
+}
+
+void Journal::append(int id, string_view entry)
+{
+    entries.push_back(id, entry);
+    next_id = max(next_id, id + 1);
 }
 
 void Journal::save(const string& filename)
 {
     ofstream ofs(filename);
-    for (auto& s : entries)
+    for (const auto& s : entries)
         ofs << s << endl;
 }
 
@@ -48,13 +61,15 @@ struct PersistenceManager
 {
     static void save(const Journal& j, const string& filename)
     {
+        TRACE_ZONE("PersistenceManager::save");
+        TRACE_COUNTER("PersistenceManager::save.Entries", j.entries.size());
         ofstream ofs(filename);
-        for (auto& s : j.entries)
+        for (const auto& s : j.entries)
             ofs << s << endl;
     }
 };
 
-void main()
+void TestSingleResponsibility()
 {
     Journal journal{"Dear Diary"};
     journal.add("I ate a bug");
@@ -63,6 +78,8 @@ void main()
     // This violates the SRP.
     //journal.save("diary.txt");
 
+    Registry::ScratchDirectory Scratch;
     PersistenceManager pm;
-    pm.save(journal, "diary.txt");
-}
\ No newline at end of file
+    pm.save(journal, Scratch.Path("diary.txt"));
+}
+REGISTER_TEST(TestSingleResponsibility, "SingleResponsibility::Test", TestSingleResponsibility);
\ No newline at end of file
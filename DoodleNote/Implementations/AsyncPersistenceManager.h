@@ -0,0 +1,202 @@
+#pragma once
+
+// Asynchronous PersistenceManager.
+// PersistenceManager::save는 디스크 I/O가 끝날 때까지 호출자를 block한다.
+// 여기서는 호출자가 Journal::entries의 snapshot만 넘기고 바로 돌아오며,
+// background writer thread가 snapshot을 파일로 쓴다. 호출자는 future로 완료를 확인한다.
+// snapshot은 entry를 복사하지 않고 Journal과 record block, chunk를 공유하므로(copy-on-write)
+// 호출자 thread에서 entry 수에 비례하는 복사를 하지 않는다.
+// 밀린 save가 MaxPendingSaves개를 넘으면 save가 block된다(back-pressure).
+
+#include "../DesignPattern/SingleResponsibility.h"
+#include "Registry.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+namespace Journaling
+{
+	using namespace std;
+
+	class AsyncPersistenceManager
+	{
+	public:
+		explicit AsyncPersistenceManager(size_t InMaxPendingSaves = 2)
+			: MaxPendingSaves(InMaxPendingSaves)
+		{
+			assert(MaxPendingSaves > 0);
+			Writer = thread([this] { WriteLoop(); });
+		}
+
+		AsyncPersistenceManager(const AsyncPersistenceManager&) = delete;
+		AsyncPersistenceManager& operator=(const AsyncPersistenceManager&) = delete;
+
+		// 밀린 save를 모두 쓴 뒤에 종료한다.
+		~AsyncPersistenceManager()
+		{
+			{
+				lock_guard<mutex> Lock(Mutex);
+				bStopping = true;
+			}
+			JobQueued.notify_one();
+			Writer.join();
+		}
+
+		future<bool> save(const Journal& j, const string& filename)
+		{
+			SaveJob Job {j.entries.snapshot(), filename, {}};
+			future<bool> Result = Job.Done.get_future();
+			{
+				// 자리가 날 때까지 기다린 lock을 놓지 않고 넣어야 다른 save가 그 자리를 가로채지 못한다.
+				unique_lock<mutex> Lock(Mutex);
+				JobDone.wait(Lock, [&] { return Jobs.size() < MaxPendingSaves; });
+				Jobs.push_back(move(Job));
+			}
+			JobQueued.notify_one();
+			return Result;
+		}
+
+		size_t PendingSaves() const
+		{
+			lock_guard<mutex> Lock(Mutex);
+			return Jobs.size();
+		}
+
+	private:
+		struct SaveJob
+		{
+			JournalEntries::Snapshot Snapshot;
+			string Filename;
+			promise<bool> Done;
+		};
+
+		void WriteLoop()
+		{
+			unique_lock<mutex> Lock(Mutex);
+			while (true)
+			{
+				JobQueued.wait(Lock, [&] { return !Jobs.empty() || bStopping; });
+				if (Jobs.empty()) break;
+
+				// 쓰는 동안에도 job은 queue에 남겨 두어 back-pressure에 포함시킨다.
+				SaveJob& Job = Jobs.front();
+				Lock.unlock();
+
+				ofstream ofs(Job.Filename);
+				for (const auto& s : Job.Snapshot)
+					ofs << s << '\n';
+				ofs.close();
+				Job.Done.set_value(!ofs.fail());
+
+				Lock.lock();
+				Jobs.pop_front();
+				JobDone.notify_all();
+			}
+		}
+
+		const size_t MaxPendingSaves;
+		thread Writer;
+
+		mutable mutex Mutex;
+		condition_variable JobQueued;
+		condition_variable JobDone;
+		deque<SaveJob> Jobs;
+		bool bStopping = false;
+	};
+
+	// 밀린 save가 MaxPendingSaves를 넘어도 모두 쓰고, 파일에는 마지막 save가 넘긴 snapshot이 남는다.
+	void TestAsyncPersistenceManager()
+	{
+		Registry::ScratchDirectory Scratch;
+		const string Path = Scratch.Path("diary.txt");
+		const string ExpectedPath = Scratch.Path("diary.expected.txt");
+
+		Journal journal{"Dear Diary"};
+		Journal Expected{"Dear Diary"};
+		vector<future<bool>> Results;
+		{
+			AsyncPersistenceManager apm(1);
+			for (int i = 0; i < 8; i++)
+			{
+				const char* Text = i % 2 ? "I ate a bug" : "I cried today";
+				journal.add(Text);
+				Expected.add(Text);
+				Results.push_back(apm.save(journal, Path));
+			}
+			// save한 뒤에 추가한 entry는 writer가 아직 쓰고 있더라도 파일에 들어가지 않는다.
+			journal.add("not saved");
+		}
+		for (auto& Result : Results)
+		{
+			const bool bSaved = Result.get();
+			CHECK(bSaved);
+		}
+
+		PersistenceManager::save(Expected, ExpectedPath);
+		auto ReadAll = [] (const string& Name) {
+			ifstream ifs(Name);
+			return string(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+		};
+		CHECK(ReadAll(Path) == ReadAll(ExpectedPath));
+	}
+	REGISTER_TEST(TestAsyncPersistenceManager, "Journaling::TestAsyncPersistenceManager", TestAsyncPersistenceManager);
+
+	// 주기적으로 save하면서 add를 계속할 때, 매 반복(add + save 호출)에 걸린 시간을 잰다.
+	void BenchmarkAsyncPersistenceManager()
+	{
+		constexpr int InitialEntries = 200000;
+		constexpr int NumAdds = 200000;
+		constexpr int SaveEvery = 20000;
+
+		auto Percentile = [] (vector<double>& Samples, double P) {
+			sort(Samples.begin(), Samples.end());
+			return Samples[static_cast<size_t>(P * (Samples.size() - 1))];
+		};
+
+		auto Run = [&] (const char* Name, auto&& Save) {
+			Journal journal{"Dear Diary"};
+			for (int i = 0; i < InitialEntries; i++)
+				journal.add("an old entry to make saves slow");
+
+			vector<double> Latencies;
+			Latencies.reserve(NumAdds);
+			const auto Start = chrono::steady_clock::now();
+			for (int i = 0; i < NumAdds; i++)
+			{
+				const auto Begin = chrono::steady_clock::now();
+				journal.add("I ate a bug");
+				if (i % SaveEvery == 0) Save(journal);
+				Latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - Begin).count());
+			}
+			const chrono::duration<double, milli> Total = chrono::steady_clock::now() - Start;
+
+			cout << Name << ": total " << Total.count() << " ms"
+				 << ", p50 " << Percentile(Latencies, 0.5) << " us"
+				 << ", p99.99 " << Percentile(Latencies, 0.9999) << " us"
+				 << ", max " << Latencies.back() << " us" << endl;
+		};
+
+		Registry::ScratchDirectory Scratch;
+		const string Path = Scratch.Path("diary.txt");
+		Run("sync ", [&] (const Journal& j) { PersistenceManager::save(j, Path); });
+
+		vector<future<bool>> Results;
+		{
+			AsyncPersistenceManager apm;
+			Run("async", [&] (const Journal& j) { Results.push_back(apm.save(j, Path)); });
+		}
+		for (auto& Result : Results)
+		{
+			const bool bSaved = Result.get();
+			CHECK(bSaved);
+		}
+	}
+	REGISTER_BENCHMARK(BenchmarkAsyncPersistenceManager, "Journaling::BenchmarkAsyncPersistenceManager", BenchmarkAsyncPersistenceManager);
+}
@@ -0,0 +1,413 @@
+#pragma once
+
+// Compact binary journal format.
+// PersistenceManager::save는 "N: " prefix가 붙은 text를 쓰므로, 읽을 때 모든 줄을 파싱하고
+// 모든 string을 다시 할당해야 한다. binary format은 Id를 정수로 저장하고, 길이를 앞에 두므로
+// 파싱이 필요없다. reader는 파일을 mmap하고 entry를 복사 없이 string_view로 보여준다.
+//
+// File:   [Header][Block]...
+// Header: [Magic: 8 bytes][Version: u32][TitleLength: u32][Title]
+// Block:  [StoredSize: u32][EntryCount: u32][Crc32(Stored): u32][RawSize: u32][Stored]
+// Entry:  [Id: varint][TextLength: varint][Text]
+// 모든 고정 크기 정수는 little-endian이다.
+// 압축을 켜면 block의 payload를 Lz77로 압축해서 저장한다. 압축해도 작아지지 않으면 그대로
+// 저장하므로, StoredSize == RawSize이면 압축하지 않은 block이다. 압축한 block은 읽을 때
+// block 단위로 해제하므로 그 entry들만 복사본을 가리킨다.
+// Version 1은 RawSize가 없고 항상 압축하지 않은 block이다.
+
+#include "../DesignPattern/SingleResponsibility.h"
+#include "Crc32.h"
+#include "FileIO.h"
+#include "Lz77.h"
+#include "Varint.h"
+#include "Registry.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <string_view>
+
+namespace Journaling
+{
+	using namespace std;
+
+	inline constexpr char BinaryJournalMagic[8] = {'D','N','J','B','I','N','0','1'};
+	inline constexpr uint32_t BinaryJournalVersion = 2;
+	inline constexpr size_t BinaryHeaderSize = 16;
+	inline constexpr size_t BinaryBlockHeaderSize = 16;
+	inline constexpr size_t BinaryBlockHeaderSizeV1 = 12;
+	// block 하나가 이 크기를 넘으면 다음 block을 시작한다.
+	inline constexpr size_t BinaryBlockTargetSize = 64 * 1024;
+	// 이보다 큰 block은 압축하지 않는다. RawSize는 CRC에 포함되지 않으므로, 읽을 때
+	// 이보다 큰 RawSize를 가진 압축 block은 손상된 것으로 보고 할당하지 않는다.
+	inline constexpr size_t BinaryMaxCompressedRawSize = 1024 * 1024;
+
+	struct JournalEntryView
+	{
+		uint64_t Id;
+		string_view Text;
+	};
+
+	inline void AppendU32(string& Out, uint32_t Value)
+	{
+		char Bytes[4];
+		memcpy(Bytes, &Value, 4);
+		Out.append(Bytes, 4);
+	}
+
+	inline uint32_t ReadU32(const char* Data)
+	{
+		uint32_t Value;
+		memcpy(&Value, Data, 4);
+		return Value;
+	}
+
+	struct BinaryJournalOptions
+	{
+		bool bCompress = false;
+		Compression::LzOptions Lz;
+	};
+
+	struct BinaryPersistenceManager
+	{
+		static bool save(const Journal& j, const string& filename, const BinaryJournalOptions& Options = {})
+		{
+			ofstream ofs(filename, ios::binary);
+
+			string Header(BinaryJournalMagic, sizeof(BinaryJournalMagic));
+			AppendU32(Header, BinaryJournalVersion);
+			AppendU32(Header, static_cast<uint32_t>(j.title.size()));
+			Header += j.title;
+			ofs.write(Header.data(), Header.size());
+
+			string Payload;
+			string Compressed;
+			Compression::LzCompressor Compressor;
+			uint32_t EntryCount = 0;
+			auto FlushBlock = [&] {
+				const string* Stored = &Payload;
+				if (Options.bCompress && Payload.size() <= BinaryMaxCompressedRawSize)
+				{
+					Compressed.clear();
+					Compressor.Compress(Payload.data(), Payload.size(), Compressed, Options.Lz);
+					if (Compressed.size() < Payload.size()) Stored = &Compressed;
+				}
+
+				string BlockHeader;
+				AppendU32(BlockHeader, static_cast<uint32_t>(Stored->size()));
+				AppendU32(BlockHeader, EntryCount);
+				AppendU32(BlockHeader, Checksum::Crc32(Stored->data(), Stored->size()));
+				AppendU32(BlockHeader, static_cast<uint32_t>(Payload.size()));
+				ofs.write(BlockHeader.data(), BlockHeader.size());
+				ofs.write(Stored->data(), Stored->size());
+				Payload.clear();
+				EntryCount = 0;
+			};
+
+			for (const auto& [Id, Text] : j.entries)
+			{
+				Varint::Write(Payload, static_cast<uint64_t>(Id));
+				Varint::Write(Payload, Text.size());
+				Payload.append(Text);
+				if (++EntryCount, Payload.size() >= BinaryBlockTargetSize) FlushBlock();
+			}
+			if (EntryCount > 0) FlushBlock();
+
+			ofs.close();
+			return !ofs.fail();
+		}
+	};
+
+	// binary journal을 mmap해서 읽는다. entry의 Text는 mapping을 가리키므로
+	// MappedJournal보다 오래 살 수 없다.
+	class MappedJournal
+	{
+	public:
+		bool Open(const string& filename)
+		{
+			Close();
+			if (!File.Open(filename)) return false;
+
+			const string_view Data = File.View();
+			const uint32_t Version = Data.size() < BinaryHeaderSize ? 0 : ReadU32(Data.data() + 8);
+			if (Data.size() < BinaryHeaderSize || memcmp(Data.data(), BinaryJournalMagic, sizeof(BinaryJournalMagic)) != 0
+				|| (Version != 1 && Version != BinaryJournalVersion))
+			{
+				Close();
+				return false;
+			}
+			const size_t BlockHeaderSize = Version == 1 ? BinaryBlockHeaderSizeV1 : BinaryBlockHeaderSize;
+
+			const uint32_t TitleLength = ReadU32(Data.data() + 12);
+			if (Data.size() - BinaryHeaderSize < TitleLength) { Close(); return false; }
+			JournalTitle = Data.substr(BinaryHeaderSize, TitleLength);
+
+			// block header만 먼저 훑어서 entry 개수를 알아낸다.
+			const size_t FirstBlock = BinaryHeaderSize + TitleLength;
+			size_t TotalEntries = 0;
+			for (size_t Offset = FirstBlock; Offset < Data.size(); )
+			{
+				if (Data.size() - Offset < BlockHeaderSize) { Close(); return false; }
+				const uint32_t StoredSize = ReadU32(Data.data() + Offset);
+				const uint32_t EntryCount = ReadU32(Data.data() + Offset + 4);
+				const uint32_t RawSize = Version == 1 ? StoredSize : ReadU32(Data.data() + Offset + 12);
+				// CRC를 보기 전이므로 entry 개수를 믿지 않는다. entry 하나는 varint 두 개라 최소 2 byte다.
+				if (RawSize != StoredSize && RawSize > BinaryMaxCompressedRawSize) { Close(); return false; }
+				if (EntryCount > RawSize / 2) { Close(); return false; }
+				TotalEntries += EntryCount;
+				Offset += BlockHeaderSize;
+				if (Data.size() - Offset < StoredSize) { Close(); return false; }
+				Offset += StoredSize;
+			}
+			Entries.reserve(TotalEntries);
+
+			// block마다 CRC를 검사하면서 entry의 위치만 기록한다.
+			// 압축하지 않은 block의 문자열은 복사하지 않는다.
+			for (size_t Offset = FirstBlock; Offset < Data.size(); )
+			{
+				const uint32_t StoredSize = ReadU32(Data.data() + Offset);
+				const uint32_t EntryCount = ReadU32(Data.data() + Offset + 4);
+				const uint32_t Crc = ReadU32(Data.data() + Offset + 8);
+				const uint32_t RawSize = Version == 1 ? StoredSize : ReadU32(Data.data() + Offset + 12);
+				Offset += BlockHeaderSize;
+
+				string_view Payload = Data.substr(Offset, StoredSize);
+				bool bOk = Checksum::Crc32(Payload.data(), Payload.size()) == Crc;
+				if (bOk && RawSize != StoredSize)
+				{
+					if (RawSize > BinaryMaxCompressedRawSize) { Close(); return false; }
+					auto& Decompressed = DecompressedBlocks.emplace_back(new char[RawSize]);
+					bOk = Compression::LzDecompress(Payload.data(), Payload.size(), Decompressed.get(), RawSize);
+					Payload = string_view(Decompressed.get(), RawSize);
+				}
+				if (!bOk || !ReadBlock(Payload, EntryCount))
+				{
+					Close();
+					return false;
+				}
+				Offset += StoredSize;
+			}
+			return true;
+		}
+
+		void Close()
+		{
+			File.Close();
+			Entries.clear();
+			DecompressedBlocks.clear();
+			JournalTitle = {};
+		}
+
+		string_view Title() const { return JournalTitle; }
+		size_t Size() const { return Entries.size(); }
+		const JournalEntryView& operator[](size_t i) const { return Entries[i]; }
+		auto begin() const { return Entries.begin(); }
+		auto end() const { return Entries.end(); }
+
+	private:
+		bool ReadBlock(string_view Payload, uint32_t EntryCount)
+		{
+			const char* Cursor = Payload.data();
+			const char* End = Payload.data() + Payload.size();
+			for (uint32_t i = 0; i < EntryCount; i++)
+			{
+				uint64_t Id, Length;
+				if (!Varint::Read(Cursor, End, Id) || !Varint::Read(Cursor, End, Length)) return false;
+				if (static_cast<uint64_t>(End - Cursor) < Length) return false;
+				Entries.push_back({Id, string_view(Cursor, static_cast<size_t>(Length))});
+				Cursor += Length;
+			}
+			return Cursor == End;
+		}
+
+		FileIO::MappedFile File;
+		string_view JournalTitle;
+		vector<JournalEntryView> Entries;
+		vector<unique_ptr<char[]>> DecompressedBlocks;
+	};
+
+	// 사람이 읽을 수 있도록 PersistenceManager::save와 같은 text로 내보낸다.
+	inline void ExportText(const MappedJournal& InJournal, ostream& os)
+	{
+		for (auto& [Id, Text] : InJournal)
+			os << Id << ": " << Text << '\n';
+	}
+
+	// NumEntries개의 entry를 text와 binary로 저장하고 읽는 시간을 비교한다. 읽은 결과가 같은지도 확인한다.
+	inline void CompareBinaryWithText(int NumEntries)
+	{
+		Journal journal{"Dear Diary"};
+		for (int i = 0; i < NumEntries; i++)
+			journal.add(i % 2 ? "I ate a bug" : "I cried today");
+
+		Registry::ScratchDirectory Scratch;
+		const string TextPath = Scratch.Path("diary.txt");
+		const string BinaryPath = Scratch.Path("diary.bin");
+		PersistenceManager::save(journal, TextPath);
+		BinaryPersistenceManager::save(journal, BinaryPath);
+
+		auto Measure = [] (auto&& Function) {
+			const auto Start = chrono::steady_clock::now();
+			Function();
+			return chrono::duration<double, milli>(chrono::steady_clock::now() - Start).count();
+		};
+
+		Journal Loaded{"Dear Diary"};
+		const double TextMs = Measure([&] {
+			ifstream ifs(TextPath);
+			for (string Line; getline(ifs, Line); )
+			{
+				const auto [Id, Text] = JournalEntry::parse(Line);
+				Loaded.append(Id, Text);
+			}
+		});
+
+		MappedJournal Mapped;
+		const double BinaryMs = Measure([&] { Mapped.Open(BinaryPath); });
+
+		cout << "text load: " << TextMs << " ms, binary mmap load: " << BinaryMs << " ms" << endl;
+		CHECK(Mapped.Title() == journal.title);
+		CHECK(Mapped.Size() == journal.entries.size());
+
+		ostringstream Exported;
+		ExportText(Mapped, Exported);
+		ostringstream Original;
+		for (const auto& s : journal.entries)
+			Original << s << '\n';
+		CHECK(Exported.str() == Original.str());
+
+		for (size_t i = 0; i < 2; i++)
+			cout << Mapped[i].Id << ": " << Mapped[i].Text << endl;
+	}
+
+	// block 여러 개에 걸칠 만큼만 만든다.
+	void TestBinaryJournal()
+	{
+		CompareBinaryWithText(20000);
+
+		// 비어 있거나 header가 잘린 파일은 열지 못한다.
+		Registry::ScratchDirectory Scratch;
+		const string EmptyPath = Scratch.Path("diary.empty.bin");
+		const string TornPath = Scratch.Path("diary.torn.bin");
+		ofstream(EmptyPath, ios::binary).close();
+		ofstream(TornPath, ios::binary).write(BinaryJournalMagic, sizeof(BinaryJournalMagic) + 2);
+		MappedJournal Broken;
+		CHECK(!Broken.Open(EmptyPath));
+		CHECK(!Broken.Open(TornPath));
+
+		// block header의 entry 개수가 터무니없이 크면 미리 할당하기 전에 거부한다.
+		const string HugeCountPath = Scratch.Path("diary.count.bin");
+		Journal Small{"Dear Diary"};
+		Small.add("I ate a bug");
+		BinaryPersistenceManager::save(Small, HugeCountPath);
+		{
+			fstream Corrupt(HugeCountPath, ios::binary | ios::in | ios::out);
+			string HugeCount;
+			AppendU32(HugeCount, 0xFFFFFFFFu);
+			Corrupt.seekp(BinaryHeaderSize + Small.title.size() + 4);
+			Corrupt.write(HugeCount.data(), HugeCount.size());
+		}
+		CHECK(!Broken.Open(HugeCountPath));
+	}
+	REGISTER_TEST(TestBinaryJournal, "Journaling::TestBinaryJournal", TestBinaryJournal);
+
+	void BenchmarkBinaryJournal()
+	{
+		CompareBinaryWithText(500000);
+	}
+	REGISTER_BENCHMARK(BenchmarkBinaryJournal, "Journaling::BenchmarkBinaryJournal", BenchmarkBinaryJournal);
+
+	// NumEntries개의 entry를 block 단위로 압축했을 때의 압축률과 속도를 잰다.
+	// 압축한 파일을 읽은 결과가 압축하지 않은 파일과 같은지도 확인한다.
+	inline void CompareCompressedWithRaw(int NumEntries)
+	{
+		const char* Texts[] = {"I ate a bug", "I cried today", "I walked the dog in the park", "It rained all day long"};
+
+		Journal journal{"Dear Diary"};
+		for (int i = 0; i < NumEntries; i++)
+			journal.add(Texts[(i * 7) % 4]);
+
+		auto Measure = [] (auto&& Function) {
+			const auto Start = chrono::steady_clock::now();
+			Function();
+			return chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+		};
+
+		// codec만의 속도. block 크기로 잘라서 압축한다.
+		string Raw;
+		for (const auto& s : journal.entries)
+			Raw.append(s.str()).push_back('\n');
+		vector<string> Blocks;
+		const double CompressSeconds = Measure([&] {
+			for (size_t Offset = 0; Offset < Raw.size(); Offset += BinaryBlockTargetSize)
+			{
+				const size_t Size = min(BinaryBlockTargetSize, Raw.size() - Offset);
+				Compression::LzCompress(Raw.data() + Offset, Size, Blocks.emplace_back());
+			}
+		});
+		string Restored(Raw.size(), '\0');
+		const double DecompressSeconds = Measure([&] {
+			size_t Offset = 0;
+			for (auto& Block : Blocks)
+			{
+				const size_t Size = min(BinaryBlockTargetSize, Raw.size() - Offset);
+				Compression::LzDecompress(Block.data(), Block.size(), Restored.data() + Offset, Size);
+				Offset += Size;
+			}
+		});
+		CHECK(Restored == Raw);
+
+		size_t CompressedSize = 0;
+		for (auto& Block : Blocks)
+			CompressedSize += Block.size();
+		const double MB = Raw.size() / (1024.0 * 1024.0);
+		cout << "codec: ratio " << static_cast<double>(Raw.size()) / CompressedSize
+			 << ", compress " << MB / CompressSeconds << " MB/s"
+			 << ", decompress " << MB / DecompressSeconds << " MB/s" << endl;
+
+		// 실제 binary journal 파일.
+		Registry::ScratchDirectory Scratch;
+		const string RawPath = Scratch.Path("diary.bin");
+		const string LzPath = Scratch.Path("diary.lz.bin");
+		const double SaveRawSeconds = Measure([&] { BinaryPersistenceManager::save(journal, RawPath); });
+		BinaryJournalOptions Compressed;
+		Compressed.bCompress = true;
+		const double SaveLzSeconds = Measure([&] { BinaryPersistenceManager::save(journal, LzPath, Compressed); });
+
+		MappedJournal RawJournal, LzJournal;
+		const double LoadRawSeconds = Measure([&] { RawJournal.Open(RawPath); });
+		const double LoadLzSeconds = Measure([&] { LzJournal.Open(LzPath); });
+		CHECK(LzJournal.Size() == journal.entries.size());
+		for (size_t i = 0; i < LzJournal.Size(); i++)
+			CHECK(LzJournal[i].Id == RawJournal[i].Id && LzJournal[i].Text == RawJournal[i].Text);
+
+		// CRC가 덮지 않는 RawSize가 손상되어도 그 크기만큼 할당하지 않고 거부한다.
+		{
+			fstream Corrupt(LzPath, ios::in | ios::out | ios::binary);
+			const uint32_t HugeRawSize = 0xFFFFFFFF;
+			Corrupt.seekp(BinaryHeaderSize + journal.title.size() + 12);
+			Corrupt.write(reinterpret_cast<const char*>(&HugeRawSize), 4);
+		}
+		MappedJournal Corrupted;
+		CHECK(!Corrupted.Open(LzPath));
+
+		cout << "file: raw " << filesystem::file_size(RawPath) << " bytes, compressed " << filesystem::file_size(LzPath) << " bytes"
+			 << ", save " << SaveRawSeconds * 1000 << " / " << SaveLzSeconds * 1000 << " ms"
+			 << ", load " << LoadRawSeconds * 1000 << " / " << LoadLzSeconds * 1000 << " ms" << endl;
+	}
+
+	void TestCompressedBinaryJournal()
+	{
+		CompareCompressedWithRaw(20000);
+	}
+	REGISTER_TEST(TestCompressedBinaryJournal, "Journaling::TestCompressedBinaryJournal", TestCompressedBinaryJournal);
+
+	void BenchmarkCompressedBinaryJournal()
+	{
+		CompareCompressedWithRaw(500000);
+	}
+	REGISTER_BENCHMARK(BenchmarkCompressedBinaryJournal, "Journaling::BenchmarkCompressedBinaryJournal", BenchmarkCompressedBinaryJournal);
+}
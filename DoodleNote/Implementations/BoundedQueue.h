@@ -0,0 +1,174 @@
+#pragma once
+
+// Bounded lock-free MPMC queue (Dmitry Vyukov's bounded MPMC queue).
+// 칸마다 sequence 번호가 있어서, producer와 consumer는 위치를 CAS로 하나 차지한 뒤
+// 그 칸의 sequence로 차례가 왔는지 확인한다. lock을 잡지 않고, 가득 차거나 비면 곧바로 false를 돌려준다.
+// capacity는 2 이상의 2의 거듭제곱이어야 하며, 아니면 생성자가 std::invalid_argument를 던진다.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include "Registry.h"
+
+namespace Parallel
+{
+	template<class T>
+	class BoundedQueue
+	{
+		struct alignas(64) Cell
+		{
+			std::atomic<size_t> Sequence;
+			T Value;
+		};
+
+	public:
+		explicit BoundedQueue(size_t Capacity) : Cells(new Cell[ValidateCapacity(Capacity)]), Mask(Capacity - 1)
+		{
+			for (size_t i = 0; i < Capacity; i++) Cells[i].Sequence.store(i, std::memory_order_relaxed);
+		}
+		BoundedQueue(const BoundedQueue&) = delete;
+		BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+		size_t Capacity() const { return Mask + 1; }
+
+		static size_t ValidateCapacity(size_t Capacity)
+		{
+			// mask로 위치를 자르므로 2의 거듭제곱이 아니면 칸을 건너뛰거나 겹쳐 쓴다.
+			if (Capacity < 2 || (Capacity & (Capacity - 1)) != 0)
+				throw std::invalid_argument("BoundedQueue capacity must be a power of two >= 2");
+			return Capacity;
+		}
+
+		bool TryPush(T Value)
+		{
+			size_t Position = EnqueuePosition.load(std::memory_order_relaxed);
+			while (true)
+			{
+				Cell& Target = Cells[Position & Mask];
+				const size_t Sequence = Target.Sequence.load(std::memory_order_acquire);
+				const intptr_t Difference = static_cast<intptr_t>(Sequence) - static_cast<intptr_t>(Position);
+				if (Difference == 0)
+				{
+					if (EnqueuePosition.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed))
+					{
+						Target.Value = std::move(Value);
+						Target.Sequence.store(Position + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (Difference < 0)
+				{
+					return false;  // 가득 찼다.
+				}
+				else
+				{
+					Position = EnqueuePosition.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		bool TryPop(T& Out)
+		{
+			size_t Position = DequeuePosition.load(std::memory_order_relaxed);
+			while (true)
+			{
+				Cell& Target = Cells[Position & Mask];
+				const size_t Sequence = Target.Sequence.load(std::memory_order_acquire);
+				const intptr_t Difference = static_cast<intptr_t>(Sequence) - static_cast<intptr_t>(Position + 1);
+				if (Difference == 0)
+				{
+					if (DequeuePosition.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed))
+					{
+						Out = std::move(Target.Value);
+						Target.Sequence.store(Position + Mask + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (Difference < 0)
+				{
+					return false;  // 비었다.
+				}
+				else
+				{
+					Position = DequeuePosition.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+	private:
+		std::unique_ptr<Cell[]> Cells;
+		const size_t Mask;
+		alignas(64) std::atomic<size_t> EnqueuePosition {0};
+		alignas(64) std::atomic<size_t> DequeuePosition {0};
+	};
+
+	// queue가 가득 차거나 비어서 기다릴 때 쓴다. 처음에는 yield하고, 오래 기다리면 잠깐씩 잔다.
+	class Backoff
+	{
+		int Count = 0;
+	public:
+		void Wait()
+		{
+			if (++Count < 32) std::this_thread::yield();
+			else std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+		void Reset() { Count = 0; }
+	};
+
+	inline void TestBoundedQueue()
+	{
+		BoundedQueue<int> Queue(4);
+		int Value = 0;
+		const bool bPoppedEmpty = Queue.TryPop(Value);
+		CHECK(!bPoppedEmpty);
+		for (int i = 0; i < 4; i++)
+		{
+			const bool bPushed = Queue.TryPush(i);
+			CHECK(bPushed);
+		}
+		const bool bPushedFull = Queue.TryPush(4);
+		CHECK(!bPushedFull);
+		for (int i = 0; i < 4; i++)
+		{
+			const bool bPopped = Queue.TryPop(Value);
+			CHECK(bPopped && Value == i);
+		}
+
+		bool bRejected = false;
+		try { BoundedQueue<int> Odd(6); } catch (const std::invalid_argument&) { bRejected = true; }
+		CHECK(bRejected);
+
+		// producer 둘, consumer 둘이 모든 값을 정확히 한 번씩 주고받는다.
+		constexpr int NumValues = 100000;
+		BoundedQueue<int> Shared(64);
+		std::atomic<long long> Total {0};
+		std::atomic<int> Received {0};
+		auto Produce = [&] (int First) {
+			Backoff Wait;
+			for (int i = First; i < NumValues; i += 2)
+				while (!Shared.TryPush(i)) Wait.Wait();
+		};
+		auto Consume = [&] {
+			Backoff Wait;
+			int Out;
+			while (Received.load() < NumValues)
+			{
+				if (Shared.TryPop(Out))
+				{
+					Total += Out;
+					Received++;
+					Wait.Reset();
+				}
+				else Wait.Wait();
+			}
+		};
+		std::thread Threads[] = {std::thread(Produce, 0), std::thread(Produce, 1), std::thread(Consume), std::thread(Consume)};
+		for (auto& Thread : Threads) Thread.join();
+		CHECK(Total == static_cast<long long>(NumValues) * (NumValues - 1) / 2);
+	}
+	REGISTER_TEST(TestBoundedQueue, "Parallel::TestBoundedQueue", TestBoundedQueue);
+}
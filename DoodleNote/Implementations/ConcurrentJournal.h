@@ -0,0 +1,198 @@
+#pragma once
+
+// Concurrent journal.
+// Journal::add는 plain vector::push_back을 쓰므로 여러 thread에서 동시에 add하면 경쟁 상태가 된다.
+// 여기서는 producer가 atomic sequence로 Id를 받고, lock-free MPSC queue에 entry를 넣는다.
+// 하나의 consumer가 collect를 호출하면 queue를 비우면서 Id 순서대로 Journal에 옮긴다.
+// Id를 받은 순서와 queue에 들어간 순서가 다를 수 있으므로, 아직 앞 Id가 도착하지 않은
+// entry는 reorder buffer에서 기다린다.
+
+#include "../DesignPattern/SingleResponsibility.h"
+#include "Registry.h"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace Journaling
+{
+	using namespace std;
+
+	// Dmitry Vyukov's intrusive MPSC queue.
+	// push는 exchange 한 번으로 끝나는 wait-free이고, pop은 하나의 consumer만 호출해야 한다.
+	template<class T>
+	class MPSCQueue
+	{
+		struct Node
+		{
+			atomic<Node*> Next {nullptr};
+			T Value;
+		};
+
+		atomic<Node*> Head;
+		Node* Tail;
+
+	public:
+		MPSCQueue() : Head(new Node), Tail(Head.load(memory_order_relaxed)) {}
+		MPSCQueue(const MPSCQueue&) = delete;
+		MPSCQueue& operator=(const MPSCQueue&) = delete;
+		~MPSCQueue()
+		{
+			while (Tail)
+			{
+				Node* Next = Tail->Next.load(memory_order_relaxed);
+				delete Tail;
+				Tail = Next;
+			}
+		}
+
+		void Push(T Value)
+		{
+			Node* NewNode = new Node;
+			NewNode->Value = move(Value);
+			Node* Prev = Head.exchange(NewNode, memory_order_acq_rel);
+			// 이 사이에는 Prev->Next가 비어 있어서 consumer는 NewNode를 아직 볼 수 없다.
+			Prev->Next.store(NewNode, memory_order_release);
+		}
+
+		optional<T> Pop()
+		{
+			Node* Next = Tail->Next.load(memory_order_acquire);
+			if (!Next) return nullopt;
+			// Next가 새로운 stub이 된다.
+			optional<T> Result {move(Next->Value)};
+			delete Tail;
+			Tail = Next;
+			return Result;
+		}
+	};
+
+	class ConcurrentJournal
+	{
+	public:
+		explicit ConcurrentJournal(const string& title) : Merged{title} {}
+
+		// 여러 thread에서 동시에 호출할 수 있다. 부여한 Id를 돌려준다.
+		uint64_t add(const string& entry)
+		{
+			const uint64_t Id = Sequence.fetch_add(1, memory_order_relaxed);
+			Queue.Push({Id, entry});
+			return Id;
+		}
+
+		// 하나의 consumer thread만 호출한다.
+		// 지금까지 도착한 entry 중 Id가 끊기지 않는 곳까지를 Journal에 옮긴다.
+		const Journal& collect()
+		{
+			while (auto Item = Queue.Pop())
+			{
+				const size_t Slot = static_cast<size_t>(Item->Id - NextToMerge);
+				if (Reorder.size() <= Slot) Reorder.resize(Slot + 1);
+				Reorder[Slot] = move(Item->Text);
+			}
+			while (!Reorder.empty() && Reorder.front())
+			{
+				Merged.append(static_cast<int>(NextToMerge++), *Reorder.front());
+				Reorder.pop_front();
+			}
+			return Merged;
+		}
+
+	private:
+		struct Item
+		{
+			uint64_t Id;
+			string Text;
+		};
+
+		atomic<uint64_t> Sequence {1};
+		MPSCQueue<Item> Queue;
+
+		// consumer만 접근한다.
+		Journal Merged;
+		uint64_t NextToMerge = 1;
+		deque<optional<string>> Reorder;
+	};
+
+	// 여러 thread가 동시에 add해도 collect한 Journal에는 모든 entry가 Id 순서로 빠짐없이 들어간다.
+	void TestConcurrentJournal()
+	{
+		constexpr int NumThreads = 4;
+		constexpr int AddsPerThread = 2000;
+
+		ConcurrentJournal Concurrent{"Dear Diary"};
+		vector<thread> Producers;
+		for (int t = 0; t < NumThreads; t++)
+		{
+			Producers.emplace_back([&, t] {
+				for (int i = 0; i < AddsPerThread; i++)
+					Concurrent.add(to_string(t) + ":" + to_string(i));
+			});
+		}
+		// producer가 add하는 동안에도 collect할 수 있다.
+		while (Concurrent.collect().entries.size() < static_cast<size_t>(NumThreads * AddsPerThread / 2))
+			this_thread::yield();
+		for (auto& Producer : Producers) Producer.join();
+
+		const Journal& Collected = Concurrent.collect();
+		CHECK(Collected.entries.size() == static_cast<size_t>(NumThreads * AddsPerThread));
+		vector<int> NextIndex(NumThreads, 0);
+		int ExpectedId = 1;
+		for (const auto [Id, Text] : Collected.entries)
+		{
+			CHECK(Id == ExpectedId++);
+			// 한 thread가 add한 entry는 그 thread가 add한 순서대로 들어간다.
+			const size_t Colon = Text.find(':');
+			const int Thread = stoi(string(Text.substr(0, Colon)));
+			CHECK(Text.substr(Colon + 1) == to_string(NextIndex[Thread]++));
+		}
+	}
+	REGISTER_TEST(TestConcurrentJournal, "Journaling::TestConcurrentJournal", TestConcurrentJournal);
+
+	// thread 수에 따른 초당 add 횟수를 mutex로 보호한 Journal과 비교한다.
+	void BenchmarkConcurrentJournal()
+	{
+		constexpr int TotalAdds = 800000;
+
+		auto Run = [&] (int NumThreads, auto&& Add) {
+			vector<thread> Producers;
+			const auto Start = chrono::steady_clock::now();
+			for (int t = 0; t < NumThreads; t++)
+			{
+				Producers.emplace_back([&] {
+					for (int i = 0; i < TotalAdds / NumThreads; i++)
+						Add("I ate a bug");
+				});
+			}
+			for (auto& Producer : Producers) Producer.join();
+			const chrono::duration<double> Elapsed = chrono::steady_clock::now() - Start;
+			return static_cast<uint64_t>(TotalAdds / NumThreads * NumThreads / Elapsed.count());
+		};
+
+		for (int NumThreads : {1, 2, 4, 8})
+		{
+			Journal Locked{"Dear Diary"};
+			mutex LockedMutex;
+			const uint64_t LockedRate = Run(NumThreads, [&] (const string& e) {
+				lock_guard<mutex> Lock(LockedMutex);
+				Locked.add(e);
+			});
+
+			ConcurrentJournal Concurrent{"Dear Diary"};
+			const uint64_t ConcurrentRate = Run(NumThreads, [&] (const string& e) { Concurrent.add(e); });
+
+			const Journal& Collected = Concurrent.collect();
+			CHECK(Collected.entries.size() == static_cast<size_t>(TotalAdds / NumThreads * NumThreads));
+			CHECK(Collected.entries.back().id == static_cast<int>(Collected.entries.size()));
+			CHECK(Collected.entries.back().text == "I ate a bug");
+
+			cout << NumThreads << " threads: mutex " << LockedRate
+				 << " adds/sec, lock-free " << ConcurrentRate << " adds/sec" << endl;
+		}
+	}
+	REGISTER_BENCHMARK(BenchmarkConcurrentJournal, "Journaling::BenchmarkConcurrentJournal", BenchmarkConcurrentJournal);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <array>
+
+// CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320).
+// 디스크에 기록한 레코드가 중간에 잘렸거나 손상되었는지 검사하는 데 사용한다.
+// 8개의 table로 한 번에 8 byte씩 처리한다(slicing-by-8).
+
+namespace Checksum
+{
+	inline const std::array<std::array<uint32_t, 256>, 8>& Crc32Tables()
+	{
+		static const auto Tables = [] {
+			std::array<std::array<uint32_t, 256>, 8> Result {};
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t Crc = i;
+				for (int Bit = 0; Bit < 8; Bit++)
+					Crc = (Crc & 1) ? (Crc >> 1) ^ 0xEDB88320u : (Crc >> 1);
+				Result[0][i] = Crc;
+			}
+			for (uint32_t i = 0; i < 256; i++)
+				for (int Slice = 1; Slice < 8; Slice++)
+					Result[Slice][i] = (Result[Slice - 1][i] >> 8) ^ Result[0][Result[Slice - 1][i] & 0xFF];
+			return Result;
+		}();
+		return Tables;
+	}
+
+	// 이전 결과를 Crc로 넘기면 여러 조각을 이어서 계산할 수 있다.
+	// little-endian을 가정한다.
+	inline uint32_t Crc32(const void* Data, size_t Size, uint32_t Crc = 0)
+	{
+		const auto& T = Crc32Tables();
+		const auto* Bytes = static_cast<const unsigned char*>(Data);
+		Crc = ~Crc;
+		for (; Size >= 8; Size -= 8, Bytes += 8)
+		{
+			uint32_t Low, High;
+			memcpy(&Low, Bytes, 4);
+			memcpy(&High, Bytes + 4, 4);
+			Low ^= Crc;
+			Crc = T[7][Low & 0xFF] ^ T[6][(Low >> 8) & 0xFF] ^ T[5][(Low >> 16) & 0xFF] ^ T[4][Low >> 24]
+				^ T[3][High & 0xFF] ^ T[2][(High >> 8) & 0xFF] ^ T[1][(High >> 16) & 0xFF] ^ T[0][High >> 24];
+		}
+		for (; Size > 0; Size--, Bytes++)
+			Crc = T[0][(Crc ^ *Bytes) & 0xFF] ^ (Crc >> 8);
+		return ~Crc;
+	}
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// ofstream은 flush까지만 보장하고 디스크에 내려갔는지는 보장하지 않는다.
+// durable한 저장에 필요한 write/sync/truncate만 얇게 감싼 low-level file이다.
+
+namespace FileIO
+{
+#ifdef _WIN32
+	inline int     OpenFile(const char* Path, int Flags)            { int Fd = -1; _sopen_s(&Fd, Path, Flags | _O_BINARY, _SH_DENYNO, _S_IREAD | _S_IWRITE); return Fd; }
+	inline void    CloseFile(int Fd)                                { _close(Fd); }
+	inline int64_t ReadFile(int Fd, void* Data, size_t Size)        { return _read(Fd, Data, static_cast<unsigned>(Size)); }
+	inline int64_t WriteFile(int Fd, const void* Data, size_t Size) { return _write(Fd, Data, static_cast<unsigned>(Size)); }
+	inline int64_t SeekFile(int Fd, int64_t Offset, int Origin)     { return _lseeki64(Fd, Offset, Origin); }
+	inline bool    SyncFile(int Fd)                                 { return _commit(Fd) == 0; }
+	inline bool    TruncateFile(int Fd, int64_t Size)               { return _chsize_s(Fd, Size) == 0; }
+	constexpr int  ReadWriteCreate = _O_RDWR | _O_CREAT;
+	constexpr int  TruncateFlag = _O_TRUNC;
+	// NTFS는 file을 만들거나 크기를 바꾼 metadata를 _commit과 함께 journal에 남긴다.
+	inline bool    SyncDirectory(const std::string&)                { return true; }
+#else
+	inline int     OpenFile(const char* Path, int Flags)            { return ::open(Path, Flags, 0644); }
+	inline void    CloseFile(int Fd)                                { ::close(Fd); }
+	inline int64_t ReadFile(int Fd, void* Data, size_t Size)        { return ::read(Fd, Data, Size); }
+	inline int64_t WriteFile(int Fd, const void* Data, size_t Size) { return ::write(Fd, Data, Size); }
+	inline int64_t SeekFile(int Fd, int64_t Offset, int Origin)     { return ::lseek(Fd, Offset, Origin); }
+	inline bool    SyncFile(int Fd)                                 { return ::fdatasync(Fd) == 0; }
+	inline bool    TruncateFile(int Fd, int64_t Size)               { return ::ftruncate(Fd, Size) == 0; }
+	constexpr int  ReadWriteCreate = O_RDWR | O_CREAT;
+	constexpr int  TruncateFlag = O_TRUNC;
+
+	// file을 새로 만들었다면 file만 fsync해서는 부족하고, 그 file이 들어 있는 directory entry도 sync해야 한다.
+	inline bool SyncDirectory(const std::string& Path)
+	{
+		const size_t Slash = Path.find_last_of('/');
+		const std::string Dir = Slash == std::string::npos ? "." : Slash == 0 ? "/" : Path.substr(0, Slash);
+		const int Fd = ::open(Dir.c_str(), O_RDONLY | O_DIRECTORY);
+		if (Fd < 0) return false;
+		const bool bOk = ::fsync(Fd) == 0;
+		::close(Fd);
+		return bOk;
+	}
+#endif
+
+	class File
+	{
+		int Fd = -1;
+	public:
+		File() = default;
+		File(const File&) = delete;
+		File& operator=(const File&) = delete;
+		~File() { Close(); }
+
+		bool Open(const std::string& Path, bool bTruncate = false)
+		{
+			Close();
+			Fd = OpenFile(Path.c_str(), ReadWriteCreate | (bTruncate ? TruncateFlag : 0));
+			return IsOpen();
+		}
+
+		void Close()
+		{
+			if (IsOpen()) CloseFile(Fd);
+			Fd = -1;
+		}
+
+		bool IsOpen() const { return Fd >= 0; }
+
+		int64_t Size() const { return SeekFile(Fd, 0, SEEK_END); }
+
+		bool ReadAll(std::vector<char>& Out) const
+		{
+			const int64_t FileSize = Size();
+			if (FileSize < 0 || SeekFile(Fd, 0, SEEK_SET) != 0) return false;
+			Out.resize(static_cast<size_t>(FileSize));
+			size_t Done = 0;
+			while (Done < Out.size())
+			{
+				const int64_t Read = ReadFile(Fd, Out.data() + Done, Out.size() - Done);
+				if (Read <= 0) return false;
+				Done += static_cast<size_t>(Read);
+			}
+			return true;
+		}
+
+		// 항상 파일의 끝에 쓴다.
+		bool Append(const void* Data, size_t Size)
+		{
+			if (SeekFile(Fd, 0, SEEK_END) < 0) return false;
+			const char* Bytes = static_cast<const char*>(Data);
+			while (Size > 0)
+			{
+				const int64_t Written = WriteFile(Fd, Bytes, Size);
+				if (Written <= 0) return false;
+				Bytes += Written;
+				Size -= static_cast<size_t>(Written);
+			}
+			return true;
+		}
+
+		bool Sync() { return SyncFile(Fd); }
+
+		bool Truncate(int64_t NewSize) { return TruncateFile(Fd, NewSize); }
+	};
+
+	// read-only memory-mapped file. 파일 내용을 복사하지 않고 그대로 읽는다.
+	class MappedFile
+	{
+		const char* Data = nullptr;
+		size_t Length = 0;
+#ifdef _WIN32
+		HANDLE Mapping = nullptr;
+#endif
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile() { Close(); }
+
+		bool Open(const std::string& Path)
+		{
+			Close();
+#ifdef _WIN32
+			HANDLE Handle = CreateFileA(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (Handle == INVALID_HANDLE_VALUE) return false;
+			LARGE_INTEGER FileSize;
+			const bool bSized = GetFileSizeEx(Handle, &FileSize) != 0;
+			Length = bSized ? static_cast<size_t>(FileSize.QuadPart) : 0;
+			if (bSized && Length > 0)
+			{
+				Mapping = CreateFileMappingA(Handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (Mapping) Data = static_cast<const char*>(MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+			}
+			CloseHandle(Handle);
+			if (!bSized || (Length > 0 && !Data)) { Close(); return false; }
+#else
+			const int Fd = ::open(Path.c_str(), O_RDONLY);
+			if (Fd < 0) return false;
+			struct stat Stat;
+			const bool bSized = ::fstat(Fd, &Stat) == 0;
+			Length = bSized ? static_cast<size_t>(Stat.st_size) : 0;
+			if (bSized && Length > 0)
+			{
+				void* Mapped = ::mmap(nullptr, Length, PROT_READ, MAP_PRIVATE, Fd, 0);
+				if (Mapped != MAP_FAILED) Data = static_cast<const char*>(Mapped);
+			}
+			::close(Fd);
+			if (!bSized || (Length > 0 && !Data)) { Close(); return false; }
+#endif
+			return true;
+		}
+
+		void Close()
+		{
+#ifdef _WIN32
+			if (Data) UnmapViewOfFile(Data);
+			if (Mapping) CloseHandle(Mapping);
+			Mapping = nullptr;
+#else
+			if (Data) ::munmap(const_cast<char*>(Data), Length);
+#endif
+			Data = nullptr;
+			Length = 0;
+		}
+
+		std::string_view View() const { return {Data, Length}; }
+	};
+}
@@ -0,0 +1,394 @@
+#pragma once
+
+// Incremental save.
+// PersistenceManager::save는 entry 하나를 추가해도 파일 전체를 다시 쓴다.
+// 여기서는 파일마다 이미 저장한 entry 개수(high-water mark)를 기억하고, 그 뒤의 entry만
+// delta log에 덧붙인다. delta log가 checkpoint에 비해 커지면 journal 전체를 binary checkpoint로
+// 다시 쓰고 log를 비운다(compaction). 그래서 save 비용은 amortized O(새 entry 수)이고,
+// 복구할 때 replay해야 하는 log의 길이도 checkpoint 크기에 비례하는 만큼으로 제한된다.
+//
+// <filename>     : BinaryPersistenceManager가 쓴 checkpoint
+// <filename>.log : [Magic][Record]..., Record의 payload는 [Index: varint][Id: varint][Text]
+// Index는 journal에서의 위치이다. checkpoint에 이미 들어 있는 Index는 복구할 때 건너뛰므로,
+// checkpoint를 교체한 직후 log를 비우기 전에 죽어도 entry가 중복되지 않는다.
+// 파일마다 마지막으로 저장한 entry와 checkpoint의 title도 기억해서, 같은 파일에 다른 journal을
+// 저장하면 delta 대신 checkpoint를 새로 쓴다.
+// Version 1(DNJDLT01) log의 payload는 [Index: varint]["N: text"]이다. 처음 열 때 version 2로 다시 쓴다.
+
+#include "BinaryJournal.h"
+#include "JournalLog.h"
+#include "Registry.h"
+
+#include <filesystem>
+#include <map>
+#include <optional>
+
+namespace Journaling
+{
+	using namespace std;
+
+	inline constexpr char DeltaLogMagic[8] = {'D','N','J','D','L','T','0','2'};
+	inline constexpr char DeltaLogMagicV1[8] = {'D','N','J','D','L','T','0','1'};
+
+	struct IncrementalPersistenceOptions
+	{
+		// log의 entry 수가 checkpoint의 entry 수 * CompactionRatio를 넘으면 compaction한다.
+		double CompactionRatio = 0.5;
+		// 작은 journal에서 너무 자주 compaction하지 않도록 한다.
+		size_t MinCompactionEntries = 1024;
+		// checkpoint를 쓸 때의 형식. 압축 여부를 여기서 고른다.
+		BinaryJournalOptions Checkpoint;
+	};
+
+	// thread-safe하지 않다.
+	class IncrementalPersistenceManager
+	{
+	public:
+		struct Stats
+		{
+			uint64_t Saves = 0;
+			uint64_t EntriesAppended = 0;
+			uint64_t Checkpoints = 0;
+		};
+
+		explicit IncrementalPersistenceManager(const IncrementalPersistenceOptions& InOptions = {}) : Options(InOptions) {}
+
+		bool save(const Journal& j, const string& filename)
+		{
+			FileState* State = OpenState(filename, nullptr);
+			if (!State) return false;
+
+			// entry가 지워지거나 다른 journal을 저장하면 delta를 만들 수 없으므로 전부 다시 쓴다.
+			if (!IsContinuation(j, *State)) return Checkpoint(j, filename, *State);
+
+			vector<char> Delta;
+			for (size_t i = State->Persisted; i < j.entries.size(); i++)
+			{
+				const auto [Id, Text] = j.entries[i];
+				EncodeDelta(Delta, i, Id, Text);
+			}
+
+			if (!Delta.empty())
+			{
+				if (!State->Log.Append(Delta.data(), Delta.size()) || !State->Log.Sync())
+				{
+					States.erase(filename);
+					return false;
+				}
+				SaveStats.EntriesAppended += j.entries.size() - State->Persisted;
+				State->LogEntries += j.entries.size() - State->Persisted;
+				State->Persisted = j.entries.size();
+				State->RememberLast(j.entries[State->Persisted - 1]);
+			}
+			SaveStats.Saves++;
+
+			const double CompactionThreshold = max<double>(static_cast<double>(Options.MinCompactionEntries),
+				State->CheckpointEntries * Options.CompactionRatio);
+			if (State->LogEntries > CompactionThreshold) return Checkpoint(j, filename, *State);
+			return true;
+		}
+
+		// checkpoint를 읽고 log를 replay해서 j를 복구한다.
+		bool load(Journal& j, const string& filename)
+		{
+			States.erase(filename);
+			j.entries.clear();
+			j.next_id = 1;
+			return OpenState(filename, &j) != nullptr;
+		}
+
+		const Stats& GetStats() const { return SaveStats; }
+
+	private:
+		struct FileState
+		{
+			FileIO::File Log;
+			size_t Persisted = 0;
+			size_t CheckpointEntries = 0;
+			size_t LogEntries = 0;
+			// 마지막으로 저장한 entry. checkpoint가 있으면 그 title도 기억한다.
+			int LastId = 0;
+			string LastText;
+			optional<string> Title;
+
+			void RememberLast(const JournalEntry& Entry)
+			{
+				LastId = Entry.id;
+				LastText = Entry.text;
+			}
+		};
+
+		// j가 파일에 저장된 entry 뒤에 새 entry만 덧붙인 journal인지 본다.
+		// 마지막으로 저장한 entry만 비교하므로 그 앞을 바꾼 것은 알아내지 못한다.
+		static bool IsContinuation(const Journal& j, const FileState& State)
+		{
+			if (j.entries.size() < State.Persisted) return false;
+			if (State.Title && *State.Title != j.title) return false;
+			if (State.Persisted == 0) return true;
+			const JournalEntry Last = j.entries[State.Persisted - 1];
+			return Last.id == State.LastId && Last.text == State.LastText;
+		}
+
+		static string LogPath(const string& filename) { return filename + ".log"; }
+
+		static void EncodeDelta(vector<char>& Out, size_t Index, int Id, string_view Text)
+		{
+			string Payload;
+			Varint::Write(Payload, Index);
+			Varint::Write(Payload, static_cast<uint64_t>(Id));
+			Payload += Text;
+			EncodeRecord(Out, Payload);
+		}
+
+		// 처음 보는 파일이면 checkpoint와 log를 읽어서 high-water mark를 복구한다.
+		FileState* OpenState(const string& filename, Journal* Recovered)
+		{
+			auto Found = States.find(filename);
+			if (Found != States.end()) return &Found->second;
+
+			FileState& State = States[filename];
+			bool bOk = true;
+			{
+				MappedJournal Checkpointed;
+				if (Checkpointed.Open(filename))
+				{
+					State.CheckpointEntries = Checkpointed.Size();
+					State.Title = string(Checkpointed.Title());
+					if (State.CheckpointEntries > 0)
+					{
+						const JournalEntryView& Last = Checkpointed[State.CheckpointEntries - 1];
+						State.RememberLast({static_cast<int>(Last.Id), Last.Text});
+					}
+					if (Recovered)
+					{
+						for (auto& [Id, Text] : Checkpointed)
+							Recovered->append(static_cast<int>(Id), Text);
+					}
+				}
+				else if (filesystem::exists(filename))
+				{
+					bOk = false;
+				}
+			}
+			State.Persisted = State.CheckpointEntries;
+
+			bOk = bOk && State.Log.Open(LogPath(filename));
+			vector<char> Data;
+			bOk = bOk && State.Log.ReadAll(Data);
+			const bool bLegacy = bOk && Data.size() >= sizeof(DeltaLogMagicV1) && memcmp(Data.data(), DeltaLogMagicV1, sizeof(DeltaLogMagicV1)) == 0;
+			if (bOk && !bLegacy && (Data.size() < sizeof(DeltaLogMagic) || memcmp(Data.data(), DeltaLogMagic, sizeof(DeltaLogMagic)) != 0))
+			{
+				// header를 쓰다가 죽었거나 새 파일이다.
+				bOk = Data.size() <= sizeof(DeltaLogMagic) && ResetLog(State.Log);
+				Data.assign(DeltaLogMagic, DeltaLogMagic + sizeof(DeltaLogMagic));
+			}
+
+			if (bOk)
+			{
+				// Index가 이어지지 않는 record부터는 torn tail과 같이 취급한다.
+				size_t ValidEnd = sizeof(DeltaLogMagic);
+				bool bContiguous = true;
+				vector<char> Migrated;
+				DecodeRecords(Data, sizeof(DeltaLogMagic), [&] (string_view Payload) {
+					const char* Cursor = Payload.data();
+					const char* End = Payload.data() + Payload.size();
+					uint64_t Index, Id = 0;
+					bContiguous = bContiguous && Varint::Read(Cursor, End, Index) && Index <= State.Persisted
+						&& (bLegacy || Varint::Read(Cursor, End, Id));
+					if (!bContiguous) return;
+
+					string_view Text(Cursor, End - Cursor);
+					if (bLegacy)
+					{
+						const JournalEntry Entry = JournalEntry::parse(Text);
+						Id = static_cast<uint64_t>(Entry.id);
+						Text = Entry.text;
+						EncodeDelta(Migrated, static_cast<size_t>(Index), static_cast<int>(Id), Text);
+					}
+					if (Index == State.Persisted)
+					{
+						if (Recovered) Recovered->append(static_cast<int>(Id), Text);
+						State.RememberLast({static_cast<int>(Id), Text});
+						State.Persisted++;
+					}
+					State.LogEntries++;
+					ValidEnd += RecordHeaderSize + Payload.size();
+				});
+				if (bLegacy)
+					bOk = MigrateLog(filename, State, Migrated);
+				else if (ValidEnd < Data.size())
+					bOk = State.Log.Truncate(static_cast<int64_t>(ValidEnd)) && State.Log.Sync();
+			}
+
+			if (!bOk)
+			{
+				States.erase(filename);
+				return nullptr;
+			}
+			return &State;
+		}
+
+		// version 1 log를 version 2 record로 다시 쓴 임시 파일로 교체한다.
+		static bool MigrateLog(const string& filename, FileState& State, const vector<char>& Records)
+		{
+			const string TempPath = LogPath(filename) + ".tmp";
+			{
+				FileIO::File Temp;
+				if (!Temp.Open(TempPath, true) || !Temp.Append(DeltaLogMagic, sizeof(DeltaLogMagic))
+					|| !Temp.Append(Records.data(), Records.size()) || !Temp.Sync())
+					return false;
+			}
+			State.Log.Close();
+			error_code Error;
+			filesystem::rename(TempPath, LogPath(filename), Error);
+			return !Error && FileIO::SyncDirectory(LogPath(filename)) && State.Log.Open(LogPath(filename));
+		}
+
+		static bool ResetLog(FileIO::File& Log)
+		{
+			return Log.Truncate(0) && Log.Append(DeltaLogMagic, sizeof(DeltaLogMagic)) && Log.Sync();
+		}
+
+		// 새 checkpoint를 임시 파일에 쓴 뒤 rename으로 교체하고, 디렉터리 항목까지 sync한 다음에야 log를 비운다.
+		bool Checkpoint(const Journal& j, const string& filename, FileState& State)
+		{
+			const string TempPath = filename + ".tmp";
+			error_code Error;
+			bool bOk = BinaryPersistenceManager::save(j, TempPath, Options.Checkpoint);
+			if (bOk)
+			{
+				FileIO::File Temp;
+				bOk = Temp.Open(TempPath) && Temp.Sync();
+			}
+			if (bOk)
+			{
+				filesystem::rename(TempPath, filename, Error);
+				bOk = !Error && FileIO::SyncDirectory(filename) && ResetLog(State.Log);
+			}
+			if (!bOk)
+			{
+				States.erase(filename);
+				return false;
+			}
+
+			State.Persisted = State.CheckpointEntries = j.entries.size();
+			State.LogEntries = 0;
+			State.Title = j.title;
+			if (!j.entries.empty()) State.RememberLast(j.entries.back());
+			SaveStats.Checkpoints++;
+			return true;
+		}
+
+		const IncrementalPersistenceOptions Options;
+		map<string, FileState> States;
+		Stats SaveStats;
+	};
+
+	// InitialEntries개가 든 journal을 저장한 뒤 entry를 하나씩 추가하며 NumSaves번 저장한다.
+	// 매번 전체를 다시 쓰는 save와 시간을 비교하고, 다시 읽은 journal이 같은지 확인한다.
+	inline void CompareIncrementalWithFull(int InitialEntries, int NumSaves)
+	{
+		Registry::ScratchDirectory Scratch;
+		const string filename = Scratch.Path("diary.jnl");
+
+		Journal journal{"Dear Diary"};
+		for (int i = 0; i < InitialEntries; i++)
+			journal.add("an old entry");
+
+		auto Measure = [] (auto&& Function) {
+			const auto Start = chrono::steady_clock::now();
+			Function();
+			return chrono::duration<double, milli>(chrono::steady_clock::now() - Start).count();
+		};
+
+		const double FullMs = Measure([&] { PersistenceManager::save(journal, Scratch.Path("diary.txt")); });
+
+		IncrementalPersistenceManager ipm;
+		const double FirstMs = Measure([&] { ipm.save(journal, filename); });
+		const double DeltaMs = Measure([&] {
+			for (int i = 0; i < NumSaves; i++)
+			{
+				journal.add("I ate a bug");
+				ipm.save(journal, filename);
+			}
+		});
+
+		cout << "full rewrite: " << FullMs << " ms/save"
+			 << ", first incremental: " << FirstMs << " ms"
+			 << ", one-entry incremental: " << DeltaMs / NumSaves << " ms/save (including sync)"
+			 << ", checkpoints: " << ipm.GetStats().Checkpoints << endl;
+
+		Journal Loaded{"Dear Diary"};
+		IncrementalPersistenceManager Reader;
+		Reader.load(Loaded, filename);
+		CHECK(Loaded.entries == journal.entries);
+		CHECK(Loaded.next_id == journal.next_id);
+		CHECK(ipm.GetStats().Checkpoints > 0);
+	}
+
+	// log가 MinCompactionEntries를 넘어서 compaction이 한 번은 일어날 만큼 저장한다.
+	void TestIncrementalPersistence()
+	{
+		CompareIncrementalWithFull(1000, 1100);
+
+		Registry::ScratchDirectory Scratch;
+		const string filename = Scratch.Path("diary.jnl");
+
+		// 같은 파일에 다른 journal을 저장하면 앞의 journal에 이어 붙이지 않고 통째로 바꾼다.
+		{
+			const string SharedPath = Scratch.Path("diary.shared.jnl");
+			Journal Mine{"Dear Diary"};
+			for (const char* Text : {"I ate a bug", "I cried today", "I walked the dog"})
+				Mine.add(Text);
+			Journal Yours{"Dear Diary"};
+			for (const char* Text : {"I fed the cat", "I read a book", "I baked bread", "I went to bed"})
+				Yours.add(Text);
+
+			IncrementalPersistenceManager Shared;
+			CHECK(Shared.save(Mine, SharedPath));
+			CHECK(Shared.save(Yours, SharedPath));
+			Journal SharedLoaded{"Dear Diary"};
+			CHECK(IncrementalPersistenceManager().load(SharedLoaded, SharedPath));
+			CHECK(SharedLoaded.entries == Yours.entries);
+
+			// 다른 manager가 파일에서 복구한 상태로도 알아낸다.
+			Yours.add("I woke up");
+			IncrementalPersistenceManager Reopened;
+			CHECK(Reopened.save(Mine, SharedPath));
+			CHECK(Reopened.save(Yours, SharedPath));
+			CHECK(IncrementalPersistenceManager().load(SharedLoaded, SharedPath));
+			CHECK(SharedLoaded.entries == Yours.entries);
+		}
+
+		// version 1 log는 읽을 수 있고, 열면서 version 2로 바뀐다.
+		{
+			vector<char> Legacy(DeltaLogMagicV1, DeltaLogMagicV1 + sizeof(DeltaLogMagicV1));
+			const char* Lines[] = {"1: I ate a bug", "2: I cried today"};
+			for (uint64_t Index = 0; Index < 2; Index++)
+			{
+				string Payload;
+				Varint::Write(Payload, Index);
+				Payload += Lines[Index];
+				EncodeRecord(Legacy, Payload);
+			}
+			ofstream(filename + ".log", ios::binary | ios::trunc).write(Legacy.data(), Legacy.size());
+		}
+		Journal Migrated{"Dear Diary"};
+		IncrementalPersistenceManager Migrator;
+		CHECK(Migrator.load(Migrated, filename));
+		CHECK(Migrated.entries.size() == 2 && Migrated.entries[1].str() == "2: I cried today" && Migrated.next_id == 3);
+		Migrated.add("I walked the dog");
+		CHECK(Migrator.save(Migrated, filename));
+
+		Journal Reloaded{"Dear Diary"};
+		CHECK(IncrementalPersistenceManager().load(Reloaded, filename));
+		CHECK(Reloaded.entries == Migrated.entries);
+	}
+	REGISTER_TEST(TestIncrementalPersistence, "Journaling::TestIncrementalPersistence", TestIncrementalPersistence);
+
+	void BenchmarkIncrementalPersistence()
+	{
+		CompareIncrementalWithFull(1000000, 2000);
+	}
+	REGISTER_BENCHMARK(BenchmarkIncrementalPersistence, "Journaling::BenchmarkIncrementalPersistence", BenchmarkIncrementalPersistence);
+}
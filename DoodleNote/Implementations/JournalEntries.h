@@ -0,0 +1,300 @@
+#pragma once
+
+// Arena-backed journal entries.
+// entry마다 to_string(id) + ": " + entry로 heap string을 만들고 Id를 text 안에 넣는 대신,
+// text는 큰 chunk(arena)에 이어서 복사하고 entry는 (id, chunk, offset, length) record로만 남긴다.
+// "N: text" 형태는 출력할 때만 만든다. entries는 JournalEntry를 돌려주는 view로 순회한다.
+// record도 고정 크기 block에 담으므로, snapshot()은 entry를 복사하지 않고 block과 chunk를 공유한다.
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Registry.h"
+
+struct JournalEntry
+{
+    int id;
+    std::string_view text;
+
+    // "N: text"
+    std::string str() const { return std::to_string(id) + ": " + std::string(text); }
+
+    // "N: text"를 (N, text)로 나눈다. prefix가 없으면 id는 0이고 text는 line 전체이다.
+    static JournalEntry parse(std::string_view line)
+    {
+        int id = 0;
+        const auto [end, error] = std::from_chars(line.data(), line.data() + line.size(), id);
+        const size_t prefix = end - line.data();
+        if (error != std::errc{} || line.substr(prefix, 2) != ": ") return {0, line};
+        return {id, line.substr(prefix + 2)};
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const JournalEntry& e)
+{
+    return os << e.id << ": " << e.text;
+}
+
+class JournalEntries
+{
+public:
+    static constexpr uint32_t chunk_size = 64 * 1024;
+    static constexpr size_t records_per_block = 4096;
+
+    template<class Owner>
+    class basic_iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = JournalEntry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = JournalEntry;
+
+        basic_iterator() = default;
+        basic_iterator(const Owner* owner, size_t index) : owner(owner), index(index) {}
+
+        JournalEntry operator*() const { return (*owner)[index]; }
+        JournalEntry operator[](difference_type n) const { return (*owner)[index + n]; }
+        basic_iterator& operator++() { ++index; return *this; }
+        basic_iterator operator++(int) { basic_iterator temp = *this; ++index; return temp; }
+        basic_iterator& operator--() { --index; return *this; }
+        basic_iterator operator--(int) { basic_iterator temp = *this; --index; return temp; }
+        basic_iterator& operator+=(difference_type n) { index += n; return *this; }
+        basic_iterator& operator-=(difference_type n) { index -= n; return *this; }
+        basic_iterator operator+(difference_type n) const { return {owner, index + n}; }
+        basic_iterator operator-(difference_type n) const { return {owner, index - n}; }
+        friend basic_iterator operator+(difference_type n, const basic_iterator& it) { return it + n; }
+        difference_type operator-(const basic_iterator& other) const { return static_cast<difference_type>(index) - static_cast<difference_type>(other.index); }
+        bool operator==(const basic_iterator& other) const { return index == other.index; }
+        auto operator<=>(const basic_iterator& other) const { return index <=> other.index; }
+
+    private:
+        const Owner* owner = nullptr;
+        size_t index = 0;
+    };
+
+    using iterator = basic_iterator<JournalEntries>;
+
+private:
+    struct Record
+    {
+        int id;
+        uint32_t chunk;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+public:
+    // snapshot()이 돌려주는 읽기 전용 view. 원본과 record block, chunk를 공유한다.
+    // 원본은 snapshot이 보는 범위 뒤에만 쓰고, 공유 중인 block을 다시 쓰기 전에는 버리므로(copy-on-write)
+    // 다른 thread에서 읽는 동안 원본에 계속 push_back해도 된다.
+    class Snapshot
+    {
+    public:
+        using iterator = basic_iterator<Snapshot>;
+
+        Snapshot() = default;
+
+        JournalEntry operator[](size_t i) const
+        {
+            const Record& r = record_blocks[i / records_per_block][i % records_per_block];
+            return {r.id, std::string_view(chunks[r.chunk].get() + r.offset, r.length)};
+        }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        iterator begin() const { return {this, 0}; }
+        iterator end() const { return {this, count}; }
+
+    private:
+        friend class JournalEntries;
+        std::vector<std::shared_ptr<const Record[]>> record_blocks;
+        std::vector<std::shared_ptr<const char[]>> chunks;
+        size_t count = 0;
+    };
+
+    JournalEntries() = default;
+    JournalEntries(JournalEntries&&) = default;
+    JournalEntries& operator=(JournalEntries&&) = default;
+    JournalEntries(const JournalEntries& other) { *this = other; }
+
+    // 이미 가진 chunk는 다시 쓰므로, 같은 객체에 반복해서 복사하면 거의 할당하지 않는다.
+    JournalEntries& operator=(const JournalEntries& other)
+    {
+        if (this == &other) return *this;
+        unshare();
+        count = other.count;
+        for (size_t b = 0; b * records_per_block < count; b++)
+        {
+            if (b == record_blocks.size()) record_blocks.push_back(new_record_block());
+            const size_t n = std::min(records_per_block, count - b * records_per_block);
+            memcpy(record_blocks[b].get(), other.record_blocks[b].get(), n * sizeof(Record));
+        }
+        chunks.resize(std::max(chunks.size(), other.chunks.size()));
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            const uint32_t used = i < other.chunks.size() ? other.chunks[i].used : 0;
+            if (chunks[i].capacity < used) chunks[i] = Chunk(other.chunks[i].capacity);
+            if (used > 0) memcpy(chunks[i].data.get(), other.chunks[i].data.get(), used);
+            chunks[i].used = used;
+        }
+        current = other.current;
+        return *this;
+    }
+
+    void push_back(int id, std::string_view text)
+    {
+        const uint32_t length = static_cast<uint32_t>(text.size());
+        if (chunks.empty() || chunks[current].capacity - chunks[current].used < length)
+            current = next_chunk(length);
+
+        Chunk& chunk = chunks[current];
+        if (length > 0) memcpy(chunk.data.get() + chunk.used, text.data(), length);
+        if (count == record_blocks.size() * records_per_block) record_blocks.push_back(new_record_block());
+        record_blocks[count / records_per_block][count % records_per_block] = {id, static_cast<uint32_t>(current), chunk.used, length};
+        count++;
+        chunk.used += length;
+    }
+
+    JournalEntry operator[](size_t i) const
+    {
+        const Record& r = record_blocks[i / records_per_block][i % records_per_block];
+        return {r.id, std::string_view(chunks[r.chunk].data.get() + r.offset, r.length)};
+    }
+
+    JournalEntry back() const { return (*this)[count - 1]; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    iterator begin() const { return {this, 0}; }
+    iterator end() const { return {this, count}; }
+
+    void reserve(size_t n) { record_blocks.reserve((n + records_per_block - 1) / records_per_block); }
+
+    // 지금까지의 entry를 복사하지 않고 공유한다. block과 chunk 수에 비례하는 pointer만 복사한다.
+    Snapshot snapshot() const
+    {
+        Snapshot result;
+        result.count = count;
+        result.record_blocks.assign(record_blocks.begin(), record_blocks.begin() + (count + records_per_block - 1) / records_per_block);
+        result.chunks.reserve(chunks.size());
+        for (auto& chunk : chunks) result.chunks.push_back(chunk.data);
+        return result;
+    }
+
+    // 할당한 chunk는 남겨 두고 다시 쓴다. snapshot이 아직 보고 있는 것은 버린다.
+    void clear()
+    {
+        unshare();
+        count = 0;
+        for (auto& chunk : chunks) chunk.used = 0;
+        current = 0;
+    }
+
+    // record와 chunk가 차지하는 byte 수.
+    size_t memory_usage() const
+    {
+        size_t bytes = record_blocks.size() * records_per_block * sizeof(Record);
+        for (auto& chunk : chunks) bytes += chunk.capacity;
+        return bytes;
+    }
+
+    bool operator==(const JournalEntries& other) const
+    {
+        return size() == other.size() && std::equal(begin(), end(), other.begin(),
+            [] (const JournalEntry& a, const JournalEntry& b) { return a.id == b.id && a.text == b.text; });
+    }
+
+private:
+    struct Chunk
+    {
+        std::shared_ptr<char[]> data;
+        uint32_t capacity = 0;
+        uint32_t used = 0;
+
+        Chunk() = default;
+        explicit Chunk(uint32_t capacity) : data(new char[capacity]), capacity(capacity) {}
+    };
+
+    static std::shared_ptr<Record[]> new_record_block() { return std::shared_ptr<Record[]>(new Record[records_per_block]); }
+
+    // snapshot이 다른 thread에서 읽고 있을 수 있는 block은 다시 쓰지 않고 버린다.
+    // use_count가 1이라면 마지막 snapshot이 해제된 것이므로, 그 해제 이전의 읽기가 모두 끝났음을 fence로 보장한다.
+    void unshare()
+    {
+        std::erase_if(record_blocks, [] (const auto& block) { return block.use_count() > 1; });
+        std::erase_if(chunks, [] (const Chunk& chunk) { return chunk.data.use_count() > 1; });
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+
+    // length를 담을 수 있는 다음 빈 chunk를 찾거나 새로 만든다.
+    // chunk_size보다 긴 text는 자기만의 chunk를 갖는다.
+    size_t next_chunk(uint32_t length)
+    {
+        for (size_t i = chunks.empty() ? 0 : current + 1; i < chunks.size(); i++)
+            if (chunks[i].used == 0 && chunks[i].capacity >= length) return i;
+        chunks.emplace_back(std::max(chunk_size, length));
+        return chunks.size() - 1;
+    }
+
+    std::vector<std::shared_ptr<Record[]>> record_blocks;
+    std::vector<Chunk> chunks;
+    size_t count = 0;
+    size_t current = 0;
+};
+
+// 기존 방식(entry마다 "N: text" heap string)과 add 시간, 메모리를 비교한다.
+inline void TestJournalEntries()
+{
+    constexpr int num_entries = 1000000;
+    const std::string entry = "I walked the dog in the park";
+
+    auto measure = [] (auto&& function) {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::vector<std::string> strings;
+    int count = 1;
+    const double string_ns = measure([&] {
+        for (int i = 0; i < num_entries; i++)
+            strings.push_back(std::to_string(count++) + ": " + entry);
+    });
+    size_t string_bytes = strings.capacity() * sizeof(std::string);
+    for (auto& s : strings)
+        if (s.capacity() > std::string().capacity()) string_bytes += s.capacity() + 1;
+
+    JournalEntries entries;
+    const double arena_ns = measure([&] {
+        for (int i = 0; i < num_entries; i++)
+            entries.push_back(i + 1, entry);
+    });
+
+    std::cout << "vector<string>: " << string_ns / num_entries << " ns/add, "
+              << static_cast<double>(string_bytes) / num_entries << " bytes/entry" << std::endl;
+    std::cout << "JournalEntries: " << arena_ns / num_entries << " ns/add, "
+              << static_cast<double>(entries.memory_usage()) / num_entries << " bytes/entry" << std::endl;
+
+    CHECK(entries.size() == strings.size());
+    CHECK(entries.back().str() == strings.back());
+
+    // snapshot은 이후의 push_back이나 clear 후 재사용에 영향을 받지 않는다.
+    const JournalEntries::Snapshot snapshot = entries.snapshot();
+    entries.push_back(0, "after snapshot");
+    entries.clear();
+    for (int i = 0; i < 10; i++) entries.push_back(-1, "overwritten");
+    CHECK(snapshot.size() == strings.size());
+    CHECK(snapshot[0].str() == strings.front() && snapshot[snapshot.size() - 1].str() == strings.back());
+}
+REGISTER_TEST(TestJournalEntries, "Journaling::TestJournalEntries", TestJournalEntries);
@@ -0,0 +1,423 @@
+#pragma once
+
+// Inverted full-text index over journal entries.
+// keyword 검색을 위해 모든 entry에 substring 검색을 하는 대신, token마다 그 token을 가진
+// entry Id들의 정렬된 목록(posting list)을 유지한다.
+// posting list는 이전 Id와의 차이(delta)를 varint로 저장하고, SkipInterval개마다 skip entry를 둔다.
+// AND는 가장 짧은 list를 기준으로 다른 list에서 skip을 galloping search로 건너뛰며 교집합을 구한다.
+// OR는 k-way merge로 합집합을 구한다.
+//
+// 색인 파일: [Magic][Crc32(Body): u32][Body]
+// Body:      [IndexedEntries][TermCount] Term...
+// Term:      [Length][Term][Count][Last][SkipCount] ([FirstId][Base][Offset])... [ByteCount][Bytes]
+// Body의 정수는 모두 varint이다.
+
+#include "BinaryJournal.h"
+#include "Registry.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <queue>
+#include <unordered_map>
+
+namespace Journaling
+{
+	using namespace std;
+
+	inline constexpr char JournalIndexMagic[8] = {'D','N','J','I','D','X','0','1'};
+
+	// 영문자와 숫자가 이어진 부분을 소문자 token으로 만든다.
+	template<class Func>
+	void ForEachToken(string_view Text, Func&& Visit)
+	{
+		string Token;
+		for (size_t i = 0; i <= Text.size(); i++)
+		{
+			const unsigned char c = i < Text.size() ? static_cast<unsigned char>(Text[i]) : ' ';
+			if (isalnum(c))
+			{
+				Token.push_back(static_cast<char>(tolower(c)));
+			}
+			else if (!Token.empty())
+			{
+				Visit(Token);
+				Token.clear();
+			}
+		}
+	}
+
+	class PostingList
+	{
+	public:
+		static constexpr uint32_t SkipInterval = 128;
+
+		struct Skip
+		{
+			uint64_t FirstId;  // block의 첫 Id
+			uint64_t Base;     // block의 첫 delta가 기준으로 하는 Id
+			uint64_t Offset;   // Bytes에서 block이 시작하는 위치
+		};
+
+		// Id는 증가하는 순서로만 추가한다.
+		void Add(uint64_t Id)
+		{
+			if (Count > 0 && Id <= Last) return;
+			if (Count % SkipInterval == 0)
+				Skips.push_back({Id, Last, Bytes.size()});
+			Varint::Write(Bytes, Id - Last);
+			Last = Id;
+			Count++;
+		}
+
+		uint32_t Size() const { return Count; }
+
+		// posting list를 차례로 읽는다. SeekGE는 skip을 galloping search로 찾는다.
+		class Cursor
+		{
+		public:
+			explicit Cursor(const PostingList& InList) : List(&InList) { LoadBlock(0); }
+
+			bool IsValid() const { return Index < List->Count; }
+			uint64_t Value() const { return Current; }
+
+			void Next()
+			{
+				if (++Index >= List->Count) return;
+				// block들은 Bytes에 이어져 있으므로 block 경계를 넘어도 그대로 읽으면 된다.
+				uint64_t Delta;
+				Varint::Read(Read, End, Delta);
+				Current += Delta;
+			}
+
+			// Target 이상인 첫 Id로 옮긴다.
+			void SeekGE(uint64_t Target)
+			{
+				if (!IsValid() || Current >= Target) return;
+
+				const auto& Skips = List->Skips;
+				const size_t Block = Index / SkipInterval;
+				if (Block + 1 < Skips.size() && Skips[Block + 1].FirstId <= Target)
+				{
+					// Target을 넘는 skip이 나올 때까지 간격을 두 배씩 늘린 뒤, 그 구간을 이분 탐색한다.
+					size_t Low = Block + 1;
+					size_t Step = 1;
+					while (Low + Step < Skips.size() && Skips[Low + Step].FirstId <= Target)
+					{
+						Low += Step;
+						Step *= 2;
+					}
+					const size_t High = min(Low + Step, Skips.size());
+					const auto Found = upper_bound(Skips.begin() + Low, Skips.begin() + High, Target,
+						[] (uint64_t Value, const Skip& InSkip) { return Value < InSkip.FirstId; });
+					LoadBlock(static_cast<size_t>(Found - Skips.begin()) - 1);
+				}
+				while (IsValid() && Current < Target)
+					Next();
+			}
+
+		private:
+			void LoadBlock(size_t Block)
+			{
+				Index = static_cast<uint32_t>(Block * SkipInterval);
+				if (!IsValid()) return;
+
+				const Skip& Start = List->Skips[Block];
+				Read = List->Bytes.data() + Start.Offset;
+				End = List->Bytes.data() + List->Bytes.size();
+				uint64_t Delta;
+				Varint::Read(Read, End, Delta);
+				Current = Start.Base + Delta;
+			}
+
+			const PostingList* List;
+			uint32_t Index = 0;
+			const char* Read = nullptr;
+			const char* End = nullptr;
+			uint64_t Current = 0;
+		};
+
+	private:
+		friend class JournalIndex;
+
+		string Bytes;
+		vector<Skip> Skips;
+		uint64_t Last = 0;
+		uint32_t Count = 0;
+	};
+
+	class JournalIndex
+	{
+	public:
+		// Id는 증가하는 순서로만 추가한다.
+		void Add(uint64_t Id, string_view Text)
+		{
+			ForEachToken(Text, [&] (const string& Token) { Terms[Token].Add(Id); });
+			IndexedEntries++;
+		}
+
+		// Journal::add 후 새 entry를 바로 색인한다.
+		void Add(Journal& InJournal, const string& Entry)
+		{
+			InJournal.add(Entry);
+			CatchUp(InJournal);
+		}
+
+		// 아직 색인하지 않은 entry만 색인한다. (예: 색인 파일을 읽은 뒤 journal이 더 자랐을 때)
+		void CatchUp(const Journal& InJournal)
+		{
+			for (size_t i = IndexedEntries; i < InJournal.entries.size(); i++)
+			{
+				const auto [Id, Text] = InJournal.entries[i];
+				Add(static_cast<uint64_t>(Id), Text);
+			}
+		}
+
+		size_t Size() const { return IndexedEntries; }
+
+		vector<uint64_t> And(const vector<string>& Query) const
+		{
+			vector<const PostingList*> Lists;
+			for (auto&& Term : NormalizeQuery(Query))
+			{
+				auto Found = Terms.find(Term);
+				if (Found == Terms.end()) return {};
+				Lists.push_back(&Found->second);
+			}
+			if (Lists.empty()) return {};
+			sort(Lists.begin(), Lists.end(), [] (auto* A, auto* B) { return A->Size() < B->Size(); });
+
+			vector<PostingList::Cursor> Cursors;
+			for (auto* List : Lists)
+				Cursors.emplace_back(*List);
+
+			vector<uint64_t> Result;
+			auto& Shortest = Cursors.front();
+			while (Shortest.IsValid())
+			{
+				const uint64_t Candidate = Shortest.Value();
+				uint64_t Next = Candidate;
+				for (size_t i = 1; i < Cursors.size(); i++)
+				{
+					Cursors[i].SeekGE(Candidate);
+					if (!Cursors[i].IsValid()) return Result;
+					Next = max(Next, Cursors[i].Value());
+				}
+				if (Next == Candidate)
+				{
+					Result.push_back(Candidate);
+					Shortest.Next();
+				}
+				else
+				{
+					Shortest.SeekGE(Next);
+				}
+			}
+			return Result;
+		}
+
+		vector<uint64_t> Or(const vector<string>& Query) const
+		{
+			using HeapItem = pair<uint64_t, size_t>;
+			vector<PostingList::Cursor> Cursors;
+			priority_queue<HeapItem, vector<HeapItem>, greater<HeapItem>> Heap;
+			for (auto&& Term : NormalizeQuery(Query))
+			{
+				auto Found = Terms.find(Term);
+				if (Found == Terms.end()) continue;
+				Cursors.emplace_back(Found->second);
+				Heap.push({Cursors.back().Value(), Cursors.size() - 1});
+			}
+
+			vector<uint64_t> Result;
+			while (!Heap.empty())
+			{
+				const auto [Id, i] = Heap.top();
+				Heap.pop();
+				if (Result.empty() || Result.back() != Id) Result.push_back(Id);
+				Cursors[i].Next();
+				if (Cursors[i].IsValid()) Heap.push({Cursors[i].Value(), i});
+			}
+			return Result;
+		}
+
+		bool Save(const string& filename) const
+		{
+			string Body;
+			Varint::Write(Body, IndexedEntries);
+			Varint::Write(Body, Terms.size());
+			for (auto& [Term, List] : Terms)
+			{
+				Varint::Write(Body, Term.size());
+				Body += Term;
+				Varint::Write(Body, List.Count);
+				Varint::Write(Body, List.Last);
+				Varint::Write(Body, List.Skips.size());
+				for (auto& [FirstId, Base, Offset] : List.Skips)
+				{
+					Varint::Write(Body, FirstId);
+					Varint::Write(Body, Base);
+					Varint::Write(Body, Offset);
+				}
+				Varint::Write(Body, List.Bytes.size());
+				Body += List.Bytes;
+			}
+
+			const string TempPath = filename + ".tmp";
+			{
+				FileIO::File Out;
+				string Header(JournalIndexMagic, sizeof(JournalIndexMagic));
+				AppendU32(Header, Checksum::Crc32(Body.data(), Body.size()));
+				if (!Out.Open(TempPath, true) || !Out.Append(Header.data(), Header.size())
+					|| !Out.Append(Body.data(), Body.size()) || !Out.Sync())
+					return false;
+			}
+			// rename한 디렉터리 항목까지 sync해야 저장이 끝난 것이다.
+			error_code Error;
+			filesystem::rename(TempPath, filename, Error);
+			return !Error && FileIO::SyncDirectory(filename);
+		}
+
+		bool Load(const string& filename)
+		{
+			*this = {};
+			FileIO::MappedFile In;
+			if (!In.Open(filename)) return false;
+
+			const string_view Data = In.View();
+			if (Data.size() < sizeof(JournalIndexMagic) + 4
+				|| memcmp(Data.data(), JournalIndexMagic, sizeof(JournalIndexMagic)) != 0)
+				return false;
+			const string_view Body = Data.substr(sizeof(JournalIndexMagic) + 4);
+			if (Checksum::Crc32(Body.data(), Body.size()) != ReadU32(Data.data() + sizeof(JournalIndexMagic)))
+				return false;
+
+			const char* Cursor = Body.data();
+			const char* End = Body.data() + Body.size();
+			auto ReadValue = [&] (auto& Value) {
+				uint64_t Read;
+				if (!Varint::Read(Cursor, End, Read)) return false;
+				Value = static_cast<remove_reference_t<decltype(Value)>>(Read);
+				return true;
+			};
+			auto ReadBytes = [&] (string& Out) {
+				uint64_t Length;
+				if (!Varint::Read(Cursor, End, Length) || static_cast<uint64_t>(End - Cursor) < Length) return false;
+				Out.assign(Cursor, static_cast<size_t>(Length));
+				Cursor += Length;
+				return true;
+			};
+
+			uint64_t TermCount;
+			bool bOk = ReadValue(IndexedEntries) && ReadValue(TermCount);
+			for (uint64_t t = 0; bOk && t < TermCount; t++)
+			{
+				string Term;
+				PostingList List;
+				uint64_t SkipCount = 0;
+				bOk = ReadBytes(Term) && ReadValue(List.Count) && ReadValue(List.Last) && ReadValue(SkipCount);
+				for (uint64_t s = 0; bOk && s < SkipCount; s++)
+				{
+					PostingList::Skip& Skip = List.Skips.emplace_back();
+					bOk = ReadValue(Skip.FirstId) && ReadValue(Skip.Base) && ReadValue(Skip.Offset);
+				}
+				bOk = bOk && ReadBytes(List.Bytes);
+				if (bOk) Terms.emplace(move(Term), move(List));
+			}
+			if (!bOk) *this = {};
+			return bOk;
+		}
+
+	private:
+		static vector<string> NormalizeQuery(const vector<string>& Query)
+		{
+			vector<string> Result;
+			for (auto&& Term : Query)
+				ForEachToken(Term, [&] (const string& Token) { Result.push_back(Token); });
+			return Result;
+		}
+
+		unordered_map<string, PostingList> Terms;
+		size_t IndexedEntries = 0;
+	};
+
+	// entry를 NumEntries개 만들어 색인하고(RareEvery개마다 "rare"를 붙인다), 전체를 훑는 검색과 결과를 비교한다.
+	// 색인 파일을 다시 읽어서 같은 결과가 나오는지도 확인한다.
+	inline void CompareIndexWithScan(int NumEntries, int RareEvery)
+	{
+		const char* Words[] = {"bug", "rain", "dog", "park", "cried", "ate", "walked", "coffee", "friend", "movie",
+							   "book", "sleep", "work", "happy", "tired", "music", "cake", "train", "snow", "sun"};
+
+		Journal journal{"Dear Diary"};
+		JournalIndex Index;
+		uint32_t Seed = 12345;
+		auto Random = [&] { Seed = Seed * 1664525u + 1013904223u; return Seed >> 8; };
+		for (int i = 0; i < NumEntries; i++)
+		{
+			string Entry = "I";
+			for (int w = 0, n = 2 + Random() % 4; w < n; w++)
+				Entry += string(" ") + Words[Random() % 20] + (i % RareEvery == 0 ? " rare" : "");
+			Index.Add(journal, Entry);
+		}
+
+		auto Scan = [&] (const vector<string>& Query, bool bAll) {
+			vector<uint64_t> Result;
+			for (const auto& [Id, Text] : journal.entries)
+			{
+				int Matched = 0;
+				for (auto& Term : Query)
+				{
+					bool bFound = false;
+					ForEachToken(Text, [&] (const string& Token) { bFound = bFound || Token == Term; });
+					Matched += bFound;
+				}
+				if (bAll ? Matched == static_cast<int>(Query.size()) : Matched > 0) Result.push_back(static_cast<uint64_t>(Id));
+			}
+			return Result;
+		};
+
+		auto Measure = [] (auto&& Function) {
+			const auto Start = chrono::steady_clock::now();
+			Function();
+			return chrono::duration<double, milli>(chrono::steady_clock::now() - Start).count();
+		};
+
+		const vector<string> RareAndDog {"rare", "dog"};
+		const vector<string> CakeOrSnow {"cake", "snow"};
+		vector<uint64_t> Indexed, Scanned;
+		const double IndexMs = Measure([&] { Indexed = Index.And(RareAndDog); });
+		const double ScanMs = Measure([&] { Scanned = Scan(RareAndDog, true); });
+		CHECK(Indexed == Scanned);
+		CHECK(Index.Or(CakeOrSnow) == Scan(CakeOrSnow, false));
+		CHECK(Index.And({"bug", "rain", "dog"}) == Scan({"bug", "rain", "dog"}, true));
+
+		cout << "AND(rare, dog): " << Indexed.size() << " entries, index " << IndexMs
+			 << " ms, scan " << ScanMs << " ms" << endl;
+
+		Registry::ScratchDirectory Scratch;
+		const string Path = Scratch.Path("diary.idx");
+		Index.Save(Path);
+		JournalIndex Loaded;
+		const double LoadMs = Measure([&] { Loaded.Load(Path); });
+		CHECK(Loaded.Size() == journal.entries.size());
+
+		// 색인을 저장한 뒤에 추가한 entry는 CatchUp으로 색인한다.
+		journal.add("a rare dog");
+		Loaded.CatchUp(journal);
+		CHECK(Loaded.And(RareAndDog) == Scan(RareAndDog, true));
+		cout << "index file: " << filesystem::file_size(Path) << " bytes, load " << LoadMs << " ms" << endl;
+	}
+
+	// 흔한 단어의 posting list가 SkipInterval보다 길어질 만큼만 만든다.
+	void TestJournalIndex()
+	{
+		CompareIndexWithScan(5000, 50);
+	}
+	REGISTER_TEST(TestJournalIndex, "Journaling::TestJournalIndex", TestJournalIndex);
+
+	void BenchmarkJournalIndex()
+	{
+		CompareIndexWithScan(300000, 1000);
+	}
+	REGISTER_BENCHMARK(BenchmarkJournalIndex, "Journaling::BenchmarkJournalIndex", BenchmarkJournalIndex);
+}
@@ -0,0 +1,347 @@
+#pragma once
+
+// Append-only journal log with group commit.
+// PersistenceManager::save는 저장할 때마다 파일 전체를 다시 쓰고, endl로 매 줄 flush한다.
+// 여기서는 새 entry만 파일 끝에 덧붙이고, 동시에 들어온 여러 Append를
+// 한 번의 write + sync로 묶어서 디스크에 내린다(group commit).
+//
+// File:   [Magic: 8 bytes][Record]...
+// Record: [Length: u32][Crc32(Payload): u32][Payload: Length bytes] (little-endian)
+// 복구할 때 Length나 Crc가 맞지 않는 첫 record부터 파일 끝까지를
+// 쓰다가 잘린 꼬리(torn tail)로 보고 잘라낸다.
+
+#include "../DesignPattern/SingleResponsibility.h"
+#include "Crc32.h"
+#include "FileIO.h"
+#include "Registry.h"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+namespace Journaling
+{
+	using namespace std;
+
+	inline constexpr char JournalLogMagic[8] = {'D','N','J','L','O','G','0','1'};
+	inline constexpr size_t RecordHeaderSize = 8;
+
+	inline void EncodeRecord(vector<char>& Out, string_view Payload)
+	{
+		const uint32_t Length = static_cast<uint32_t>(Payload.size());
+		const uint32_t Crc = Checksum::Crc32(Payload.data(), Payload.size());
+		const size_t Offset = Out.size();
+		Out.resize(Offset + RecordHeaderSize + Payload.size());
+		memcpy(Out.data() + Offset, &Length, 4);
+		memcpy(Out.data() + Offset + 4, &Crc, 4);
+		memcpy(Out.data() + Offset + RecordHeaderSize, Payload.data(), Payload.size());
+	}
+
+	// Data[Offset..]에서 온전한 record들을 읽고, 마지막 온전한 record의 끝 offset을 돌려준다.
+	template<class Func>
+	size_t DecodeRecords(const vector<char>& Data, size_t Offset, Func&& Visit)
+	{
+		while (Data.size() - Offset >= RecordHeaderSize)
+		{
+			uint32_t Length, Crc;
+			memcpy(&Length, Data.data() + Offset, 4);
+			memcpy(&Crc, Data.data() + Offset + 4, 4);
+			if (Data.size() - Offset - RecordHeaderSize < Length) break;
+
+			const string_view Payload(Data.data() + Offset + RecordHeaderSize, Length);
+			if (Checksum::Crc32(Payload.data(), Payload.size()) != Crc) break;
+
+			Visit(Payload);
+			Offset += RecordHeaderSize + Length;
+		}
+		return Offset;
+	}
+
+	struct JournalLogOptions
+	{
+		// 이만큼 모이면 더 기다리지 않고 바로 sync한다.
+		size_t MaxBatchEntries = 256;
+		// batch의 첫 entry가 들어온 후 다른 entry를 모으기 위해 기다리는 최대 시간.
+		chrono::microseconds MaxBatchDelay {200};
+	};
+
+	class JournalLog
+	{
+	public:
+		struct Stats
+		{
+			uint64_t Entries = 0;
+			uint64_t Batches = 0;
+			uint64_t Bytes = 0;
+			uint64_t TruncatedBytes = 0;
+		};
+
+		explicit JournalLog(const JournalLogOptions& InOptions = {}) : Options(InOptions) {}
+		JournalLog(const JournalLog&) = delete;
+		JournalLog& operator=(const JournalLog&) = delete;
+		~JournalLog() { Close(); }
+
+		// 파일을 열고 온전한 entry들을 Recovered에 읽어온다. 잘린 꼬리는 잘라낸다.
+		bool Open(const string& Path, vector<string>* Recovered = nullptr)
+		{
+			Close();
+			if (!LogFile.Open(Path)) return false;
+
+			vector<char> Data;
+			if (!LogFile.ReadAll(Data)) return false;
+
+			// header조차 다 쓰지 못하고 죽었다면 빈 log와 같다.
+			if (Data.size() < sizeof(JournalLogMagic))
+			{
+				if (!LogFile.Truncate(0) || !LogFile.Append(JournalLogMagic, sizeof(JournalLogMagic)) || !LogFile.Sync()
+					|| !FileIO::SyncDirectory(Path))
+					return false;
+				LogStats.TruncatedBytes = Data.size();
+				Data.assign(JournalLogMagic, JournalLogMagic + sizeof(JournalLogMagic));
+			}
+			else if (memcmp(Data.data(), JournalLogMagic, sizeof(JournalLogMagic)) != 0)
+			{
+				LogFile.Close();
+				return false;
+			}
+
+			const size_t ValidEnd = DecodeRecords(Data, sizeof(JournalLogMagic), [&] (string_view Payload) {
+				if (Recovered) Recovered->emplace_back(Payload);
+				LogStats.Entries++;
+			});
+			if (ValidEnd < Data.size())
+			{
+				if (!LogFile.Truncate(static_cast<int64_t>(ValidEnd)) || !LogFile.Sync() || !FileIO::SyncDirectory(Path))
+					return false;
+				LogStats.TruncatedBytes += Data.size() - ValidEnd;
+			}
+
+			bStopping = false;
+			bFailed = false;
+			Flusher = thread([this] { FlushLoop(); });
+			return true;
+		}
+
+		void Close()
+		{
+			if (Flusher.joinable())
+			{
+				{
+					lock_guard<mutex> Lock(Mutex);
+					bStopping = true;
+				}
+				FlushRequested.notify_one();
+				Flusher.join();
+			}
+			LogFile.Close();
+		}
+
+		// Entry가 디스크에 sync될 때까지 block한다. 여러 thread에서 호출할 수 있다.
+		bool Append(string_view Entry)
+		{
+			unique_lock<mutex> Lock(Mutex);
+			if (!Flusher.joinable() || bFailed) return false;
+
+			EncodeRecord(Pending, Entry);
+			const uint64_t Ticket = ++AppendedSeq;
+			if (++PendingCount == 1 || PendingCount >= Options.MaxBatchEntries)
+				FlushRequested.notify_one();
+
+			Durable.wait(Lock, [&] { return DurableSeq >= Ticket || bFailed; });
+			return DurableSeq >= Ticket;
+		}
+
+		// Journal::add 후 새 entry를 "N: text" 형태로 durable하게 남긴다.
+		// Journal 자체는 thread-safe하지 않으므로 add와 "N: text"를 만드는 동안 JournalMutex를 잡는다.
+		// 같은 Journal을 이 log를 거치지 않고 다른 thread에서 동시에 고치면 안된다.
+		bool Add(Journal& InJournal, const string& Entry)
+		{
+			string Line;
+			{
+				lock_guard<mutex> Lock(JournalMutex);
+				InJournal.add(Entry);
+				Line = InJournal.entries.back().str();
+			}
+			return Append(Line);
+		}
+
+		Stats GetStats() const
+		{
+			lock_guard<mutex> Lock(Mutex);
+			return LogStats;
+		}
+
+	private:
+		void FlushLoop()
+		{
+			vector<char> Writing;
+			unique_lock<mutex> Lock(Mutex);
+			while (true)
+			{
+				FlushRequested.wait(Lock, [&] { return PendingCount > 0 || bStopping; });
+				if (PendingCount == 0) break;
+
+				// 다른 producer들이 합류할 수 있도록 잠시 기다린다.
+				FlushRequested.wait_for(Lock, Options.MaxBatchDelay, [&] {
+					return PendingCount >= Options.MaxBatchEntries || bStopping;
+				});
+
+				// 쓰는 동안 producer들은 비워진 Pending에 계속 append할 수 있다.
+				Writing.clear();
+				swap(Writing, Pending);
+				const uint64_t BatchSeq = AppendedSeq;
+				const size_t BatchCount = PendingCount;
+				PendingCount = 0;
+
+				Lock.unlock();
+				const bool bOk = LogFile.Append(Writing.data(), Writing.size()) && LogFile.Sync();
+				Lock.lock();
+
+				if (bOk)
+				{
+					DurableSeq = BatchSeq;
+					LogStats.Entries += BatchCount;
+					LogStats.Batches++;
+					LogStats.Bytes += Writing.size();
+				}
+				else
+				{
+					bFailed = true;
+				}
+				Durable.notify_all();
+			}
+		}
+
+		const JournalLogOptions Options;
+		FileIO::File LogFile;
+		thread Flusher;
+
+		mutable mutex Mutex;
+		mutex JournalMutex;
+		condition_variable FlushRequested;
+		condition_variable Durable;
+		vector<char> Pending;
+		size_t PendingCount = 0;
+		uint64_t AppendedSeq = 0;
+		uint64_t DurableSeq = 0;
+		bool bStopping = false;
+		bool bFailed = false;
+		Stats LogStats;
+	};
+
+	// NumThreads개의 thread가 동시에 EntriesPerThread개씩 Append하고 걸린 시간(초)을 돌려준다.
+	inline double AppendConcurrently(JournalLog& Log, int NumThreads, int EntriesPerThread)
+	{
+		const auto Start = chrono::steady_clock::now();
+		vector<thread> Producers;
+		for (int t = 0; t < NumThreads; t++)
+		{
+			Producers.emplace_back([&Log, t, EntriesPerThread] {
+				for (int i = 0; i < EntriesPerThread; i++)
+					Log.Append("thread " + to_string(t) + " entry " + to_string(i));
+			});
+		}
+		for (auto& Producer : Producers) Producer.join();
+		return chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+	}
+
+	void TestJournalLog()
+	{
+		Registry::ScratchDirectory Scratch;
+		const string Path = Scratch.Path("diary.log");
+
+		constexpr int NumThreads = 4;
+		constexpr int EntriesPerThread = 50;
+		{
+			JournalLog Log;
+			const bool bOpened = Log.Open(Path);
+			CHECK(bOpened);
+			AppendConcurrently(Log, NumThreads, EntriesPerThread);
+			CHECK(Log.GetStats().Entries == NumThreads * EntriesPerThread);
+		}
+
+		// 마지막 record를 쓰다가 죽은 상황을 흉내낸다.
+		{
+			FileIO::File Torn;
+			const bool bOpened = Torn.Open(Path);
+			CHECK(bOpened);
+			const char Partial[] = {42, 0, 0, 0, 1, 2};
+			const bool bAppended = Torn.Append(Partial, sizeof(Partial));
+			CHECK(bAppended);
+		}
+
+		{
+			vector<string> Recovered;
+			JournalLog Log;
+			const bool bOpened = Log.Open(Path, &Recovered);
+			CHECK(bOpened);
+			cout << "recovered entries: " << Recovered.size()
+				 << ", truncated bytes: " << Log.GetStats().TruncatedBytes << endl;
+			CHECK(Recovered.size() == NumThreads * EntriesPerThread);
+		}
+
+		std::remove(Path.c_str());
+		{
+			Journal journal{"Dear Diary"};
+			JournalLog Log;
+			const bool bOpened = Log.Open(Path);
+			CHECK(bOpened);
+			Log.Add(journal, "I ate a bug");
+			Log.Add(journal, "I cried today");
+
+			// 여러 thread가 같은 Journal에 Add해도 id가 겹치지 않는다.
+			vector<thread> Writers;
+			for (int t = 0; t < 2; t++)
+				Writers.emplace_back([&] { for (int i = 0; i < 50; i++) Log.Add(journal, "entry"); });
+			for (auto& Writer : Writers) Writer.join();
+		}
+
+		// Journal::add로 남긴 entry는 다시 Journal로 읽어올 수 있다.
+		Journal journal{"Dear Diary"};
+		vector<string> Recovered;
+		JournalLog Log;
+		const bool bOpened = Log.Open(Path, &Recovered);
+		CHECK(bOpened);
+		for (auto& Line : Recovered)
+		{
+			const auto [Id, Text] = JournalEntry::parse(Line);
+			journal.append(Id, Text);
+		}
+		CHECK(Recovered.size() == 102);
+		vector<bool> Seen(Recovered.size() + 1);
+		for (const auto& s : journal.entries)
+		{
+			CHECK(s.id >= 1 && s.id <= 102 && !Seen[s.id]);
+			Seen[s.id] = true;
+			if (s.id <= 2) cout << s << endl;
+		}
+	}
+	REGISTER_TEST(TestJournalLog, "Journaling::TestJournalLog", TestJournalLog);
+
+	// 여러 thread가 Append할 때 sync 한 번에 몇 개의 entry를 묶는지와 초당 durable entry 수를 잰다.
+	void BenchmarkJournalLog()
+	{
+		Registry::ScratchDirectory Scratch;
+		const string Path = Scratch.Path("diary.log");
+
+		constexpr int NumThreads = 8;
+		constexpr int EntriesPerThread = 2000;
+		JournalLog Log;
+		const bool bOpened = Log.Open(Path);
+		CHECK(bOpened);
+		const double Elapsed = AppendConcurrently(Log, NumThreads, EntriesPerThread);
+
+		const auto Stats = Log.GetStats();
+		CHECK(Stats.Entries == NumThreads * EntriesPerThread);
+		cout << "durable entries: " << Stats.Entries
+			 << ", syncs: " << Stats.Batches
+			 << ", entries/sec: " << static_cast<uint64_t>(Stats.Entries / Elapsed) << endl;
+	}
+	REGISTER_BENCHMARK(BenchmarkJournalLog, "Journaling::BenchmarkJournalLog", BenchmarkJournalLog);
+}
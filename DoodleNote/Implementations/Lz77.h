@@ -0,0 +1,193 @@
+#pragma once
+
+// LZ77 block compressor (LZ4-like byte format, hash-chain matcher).
+// 외부 라이브러리 없이 block 단위로 압축/해제한다.
+//
+// Sequence: [Token][LiteralLength ext...][Literals][Offset: u16][MatchLength ext...]
+// Token의 상위 4 bit는 literal 길이, 하위 4 bit는 (match 길이 - MinMatch)이다.
+// 값이 15이면 뒤따르는 byte들을 255가 아닌 byte가 나올 때까지 더한다.
+// 마지막 sequence는 literal만 가지고, 입력이 거기서 끝난다.
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Compression
+{
+	inline constexpr size_t LzMinMatch = 4;
+	inline constexpr size_t LzWindowSize = 1 << 16;
+	inline constexpr int LzHashBits = 15;
+
+	struct LzOptions
+	{
+		// 한 위치에서 따라가 볼 hash chain의 최대 길이. 클수록 압축률이 좋고 느리다.
+		int MaxChainDepth = 16;
+	};
+
+	namespace Private
+	{
+		inline uint32_t Hash4(const unsigned char* Data)
+		{
+			uint32_t Value;
+			memcpy(&Value, Data, 4);
+			return (Value * 2654435761u) >> (32 - LzHashBits);
+		}
+
+		inline void WriteLength(std::string& Out, size_t Length)
+		{
+			for (; Length >= 255; Length -= 255)
+				Out.push_back(static_cast<char>(255));
+			Out.push_back(static_cast<char>(Length));
+		}
+
+		inline bool ReadLength(const unsigned char*& Cursor, const unsigned char* End, size_t& Length)
+		{
+			unsigned char Byte;
+			do
+			{
+				if (Cursor == End) return false;
+				Byte = *Cursor++;
+				Length += Byte;
+			} while (Byte == 255);
+			return true;
+		}
+
+		inline void WriteSequence(std::string& Out, const unsigned char* Literals, size_t LiteralLength, size_t MatchLength, size_t Offset)
+		{
+			const size_t MatchCode = MatchLength ? MatchLength - LzMinMatch : 0;
+			Out.push_back(static_cast<char>((std::min<size_t>(LiteralLength, 15) << 4) | std::min<size_t>(MatchCode, 15)));
+			if (LiteralLength >= 15) WriteLength(Out, LiteralLength - 15);
+			Out.append(reinterpret_cast<const char*>(Literals), LiteralLength);
+			if (MatchLength == 0) return;
+			Out.push_back(static_cast<char>(Offset & 0xFF));
+			Out.push_back(static_cast<char>(Offset >> 8));
+			if (MatchCode >= 15) WriteLength(Out, MatchCode - 15);
+		}
+	}
+
+	// hash table을 호출 사이에 재사용하는 compressor. 하나를 여러 thread에서 동시에 쓰면 안된다.
+	// table에는 지금까지 압축한 byte 수(Base)를 더한 위치를 저장하므로, Base보다 작은 값은
+	// 이전 호출이 남긴 것이다. 그래서 호출마다 table을 비우지 않아도 된다.
+	class LzCompressor
+	{
+	public:
+		LzCompressor() : Head(size_t(1) << LzHashBits, -1), Prev(LzWindowSize, -1) {}
+
+		// Src를 압축해서 Out 뒤에 덧붙인다. Size는 INT32_MAX 이하여야 한다.
+		void Compress(const char* Src, size_t Size, std::string& Out, const LzOptions& Options = {})
+		{
+			using namespace Private;
+			assert(Size <= static_cast<size_t>(INT32_MAX));
+			if (static_cast<size_t>(INT32_MAX) - Base < Size)
+			{
+				std::fill(Head.begin(), Head.end(), -1);
+				std::fill(Prev.begin(), Prev.end(), -1);
+				Base = 0;
+			}
+			const auto* Data = reinterpret_cast<const unsigned char*>(Src);
+			const int32_t First = static_cast<int32_t>(Base);
+
+			size_t Anchor = 0;
+			size_t Pos = 0;
+			auto Insert = [&] (size_t At) {
+				const uint32_t Hash = Hash4(Data + At);
+				Prev[At & (LzWindowSize - 1)] = Head[Hash];
+				Head[Hash] = First + static_cast<int32_t>(At);
+			};
+
+			while (Pos + LzMinMatch <= Size)
+			{
+				size_t BestLength = 0;
+				size_t BestOffset = 0;
+				int32_t Candidate = Head[Hash4(Data + Pos)];
+				for (int Depth = 0; Depth < Options.MaxChainDepth && Candidate >= First; Depth++)
+				{
+					const size_t At = static_cast<size_t>(Candidate - First);
+					const size_t Offset = Pos - At;
+					if (Offset >= LzWindowSize) break;
+
+					size_t Length = 0;
+					const size_t MaxLength = Size - Pos;
+					while (Length + 8 <= MaxLength && memcmp(Data + At + Length, Data + Pos + Length, 8) == 0) Length += 8;
+					while (Length < MaxLength && Data[At + Length] == Data[Pos + Length]) Length++;
+
+					if (Length > BestLength)
+					{
+						BestLength = Length;
+						BestOffset = Offset;
+					}
+					Candidate = Prev[At & (LzWindowSize - 1)];
+				}
+
+				if (BestLength < LzMinMatch)
+				{
+					Insert(Pos++);
+					continue;
+				}
+
+				WriteSequence(Out, Data + Anchor, Pos - Anchor, BestLength, BestOffset);
+				const size_t MatchEnd = Pos + BestLength;
+				for (; Pos < MatchEnd; Pos++)
+					if (Pos + LzMinMatch <= Size) Insert(Pos);
+				Anchor = Pos;
+			}
+			WriteSequence(Out, Data + Anchor, Size - Anchor, 0, 0);
+			Base += Size;
+		}
+
+	private:
+		std::vector<int32_t> Head;
+		std::vector<int32_t> Prev;
+		size_t Base = 0;
+	};
+
+	// Src를 압축해서 Out 뒤에 덧붙인다. thread마다 LzCompressor 하나를 재사용한다.
+	inline void LzCompress(const char* Src, size_t Size, std::string& Out, const LzOptions& Options = {})
+	{
+		thread_local LzCompressor Compressor;
+		Compressor.Compress(Src, Size, Out, Options);
+	}
+
+	// 압축 해제한 결과가 정확히 DstSize byte가 아니거나 입력이 손상되었으면 false이다.
+	inline bool LzDecompress(const char* Src, size_t SrcSize, char* Dst, size_t DstSize)
+	{
+		using namespace Private;
+		const auto* Cursor = reinterpret_cast<const unsigned char*>(Src);
+		const auto* End = Cursor + SrcSize;
+		auto* Out = reinterpret_cast<unsigned char*>(Dst);
+		auto* OutEnd = Out + DstSize;
+
+		while (Cursor < End)
+		{
+			const unsigned char Token = *Cursor++;
+
+			size_t LiteralLength = Token >> 4;
+			if (LiteralLength == 15 && !ReadLength(Cursor, End, LiteralLength)) return false;
+			if (static_cast<size_t>(End - Cursor) < LiteralLength || static_cast<size_t>(OutEnd - Out) < LiteralLength) return false;
+			memcpy(Out, Cursor, LiteralLength);
+			Cursor += LiteralLength;
+			Out += LiteralLength;
+			if (Cursor == End) break;
+
+			if (End - Cursor < 2) return false;
+			const size_t Offset = Cursor[0] | (Cursor[1] << 8);
+			Cursor += 2;
+			size_t MatchLength = Token & 0x0F;
+			if (MatchLength == 15 && !ReadLength(Cursor, End, MatchLength)) return false;
+			MatchLength += LzMinMatch;
+
+			if (Offset == 0 || static_cast<size_t>(Out - reinterpret_cast<unsigned char*>(Dst)) < Offset) return false;
+			if (static_cast<size_t>(OutEnd - Out) < MatchLength) return false;
+			// match가 자기 자신과 겹칠 수 있으므로(Offset < MatchLength) 앞에서부터 복사한다.
+			const unsigned char* Match = Out - Offset;
+			if (Offset >= MatchLength) memcpy(Out, Match, MatchLength);
+			else for (size_t i = 0; i < MatchLength; i++) Out[i] = Match[i];
+			Out += MatchLength;
+		}
+		return Out == OutEnd;
+	}
+}
@@ -0,0 +1,306 @@
+#pragma once
+
+// State-space explorer for Hofstadter's MU puzzle.
+// Contracts.h의 MUPuzzle은 I와 U의 개수만 흉내내지만, 여기서는 실제 문자열에 네 규칙을 적용해
+// "MI"에서 도달할 수 있는 모든 문자열을 너비 우선으로 찾는다.
+//   Rule 1: xI  -> xIU
+//   Rule 2: Mx  -> Mxx
+//   Rule 3: III -> U
+//   Rule 4: UU  -> (삭제)
+// 길이가 MaxLength를 넘는 문자열은 만들지 않으므로, 결과는 "M 뒤의 길이가 MaxLength 이하인 문자열만
+// 거쳐서 도달할 수 있는 상태"의 집합이다. 그 안에 "MU"가 없음을 확인한다.
+//
+// 상태는 맨 앞의 M을 뺀 나머지를 bit 하나에 한 글자(I = 0, U = 1)로 압축하고,
+// 상위 6 bit에 길이를 넣은 uint64_t 하나로 표현한다.
+// 한 단계(level)의 frontier를 chunk로 나누어 thread pool에서 펼치고, 방문 집합은 shard마다 lock이 있는 hash set이다.
+
+#include "../ComputerProgramming/Contracts.h"
+#include "ThreadPool.h"
+#include "Registry.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Examples::MU_Puzzle
+{
+	struct MuState
+	{
+		static constexpr int LengthShift = 58;
+		static constexpr int MaxLength = LengthShift;
+		static constexpr uint64_t SymbolMask = (uint64_t(1) << LengthShift) - 1;
+
+		uint64_t Bits = 0;
+
+		static constexpr MuState Make(uint64_t Symbols, int Length)
+		{
+			return {Symbols | (uint64_t(Length) << LengthShift)};
+		}
+
+		// "MIU" 같은 문자열을 받는다. M으로 시작하지 않거나 I, U 외의 글자가 있으면 false.
+		static bool Parse(std::string_view Text, MuState& Out)
+		{
+			if (Text.empty() || Text[0] != 'M' || Text.size() - 1 > static_cast<size_t>(MaxLength)) return false;
+			uint64_t Symbols = 0;
+			for (size_t i = 1; i < Text.size(); i++)
+			{
+				if (Text[i] == 'U') Symbols |= uint64_t(1) << (i - 1);
+				else if (Text[i] != 'I') return false;
+			}
+			Out = Make(Symbols, static_cast<int>(Text.size() - 1));
+			return true;
+		}
+
+		int Length() const { return static_cast<int>(Bits >> LengthShift); }
+		uint64_t Symbols() const { return Bits & SymbolMask; }
+		int CountI() const { return Length() - std::popcount(Symbols()); }
+		bool IsU(int i) const { return (Bits >> i) & 1; }
+
+		std::string ToString() const
+		{
+			std::string Text = "M";
+			for (int i = 0; i < Length(); i++) Text += IsU(i) ? 'U' : 'I';
+			return Text;
+		}
+
+		bool operator==(const MuState&) const = default;
+	};
+
+	// State에 네 규칙을 적용해서 길이가 MaxLength 이하인 결과를 모두 Visit한다.
+	template<class Func>
+	void ForEachSuccessor(MuState State, int MaxLength, Func&& Visit)
+	{
+		const int Length = State.Length();
+		const uint64_t Symbols = State.Symbols();
+		auto Low = [Symbols] (int i) { return Symbols & ((uint64_t(1) << i) - 1); };
+
+		// Rule 1: 마지막 글자가 I면 U를 붙인다.
+		if (Length > 0 && !State.IsU(Length - 1) && Length + 1 <= MaxLength)
+			Visit(MuState::Make(Symbols | (uint64_t(1) << Length), Length + 1));
+		// Rule 2: M 뒤를 두 번 반복한다.
+		if (Length > 0 && 2 * Length <= MaxLength)
+			Visit(MuState::Make(Symbols | (Symbols << Length), 2 * Length));
+		for (int i = 0; i + 2 < Length; i++)
+		{
+			// Rule 3: III를 U로 바꾼다.
+			if (((Symbols >> i) & 7) == 0)
+				Visit(MuState::Make(Low(i) | (uint64_t(1) << i) | ((Symbols >> (i + 3)) << (i + 1)), Length - 2));
+		}
+		for (int i = 0; i + 1 < Length; i++)
+		{
+			// Rule 4: UU를 지운다.
+			if (((Symbols >> i) & 3) == 3)
+				Visit(MuState::Make(Low(i) | ((Symbols >> (i + 2)) << i), Length - 2));
+		}
+	}
+
+	// shard마다 mutex와 open addressing table을 두어 여러 thread가 동시에 Insert할 수 있다.
+	// 0은 빈 칸을 뜻한다. 도달할 수 있는 상태는 I가 적어도 하나 있으므로 길이가 0이 아니고, Bits도 0이 아니다.
+	class VisitedSet
+	{
+		static constexpr size_t NumShards = 256;
+
+		struct alignas(64) Shard
+		{
+			std::mutex Mutex;
+			std::vector<uint64_t> Slots = std::vector<uint64_t>(64, 0);
+			size_t Count = 0;
+		};
+
+	public:
+		// 새로 넣었으면 true, 이미 있었으면 false.
+		bool Insert(uint64_t Key)
+		{
+			assert(Key != 0);
+			const uint64_t Hash = Mix(Key);
+			Shard& Target = Shards[Hash % NumShards];
+			std::lock_guard Lock(Target.Mutex);
+			if (!InsertSlot(Target.Slots, Hash / NumShards, Key)) return false;
+			if (++Target.Count * 4 > Target.Slots.size() * 3) Grow(Target);
+			return true;
+		}
+
+		bool Contains(uint64_t Key)
+		{
+			const uint64_t Hash = Mix(Key);
+			Shard& Target = Shards[Hash % NumShards];
+			std::lock_guard Lock(Target.Mutex);
+			const size_t Mask = Target.Slots.size() - 1;
+			for (size_t i = (Hash / NumShards) & Mask; Target.Slots[i] != 0; i = (i + 1) & Mask)
+			{
+				if (Target.Slots[i] == Key) return true;
+			}
+			return false;
+		}
+
+		size_t Size()
+		{
+			size_t Total = 0;
+			for (auto& Each : Shards)
+			{
+				std::lock_guard Lock(Each.Mutex);
+				Total += Each.Count;
+			}
+			return Total;
+		}
+
+	private:
+		// splitmix64 finalizer
+		static uint64_t Mix(uint64_t Key)
+		{
+			Key = (Key ^ (Key >> 30)) * 0xbf58476d1ce4e5b9ull;
+			Key = (Key ^ (Key >> 27)) * 0x94d049bb133111ebull;
+			return Key ^ (Key >> 31);
+		}
+
+		static bool InsertSlot(std::vector<uint64_t>& Slots, uint64_t Hash, uint64_t Key)
+		{
+			const size_t Mask = Slots.size() - 1;
+			size_t i = Hash & Mask;
+			for (; Slots[i] != 0; i = (i + 1) & Mask)
+			{
+				if (Slots[i] == Key) return false;
+			}
+			Slots[i] = Key;
+			return true;
+		}
+
+		static void Grow(Shard& Target)
+		{
+			std::vector<uint64_t> Slots(Target.Slots.size() * 2, 0);
+			for (uint64_t Key : Target.Slots)
+			{
+				if (Key != 0) InsertSlot(Slots, Mix(Key) / NumShards, Key);
+			}
+			Target.Slots.swap(Slots);
+		}
+
+		Shard Shards[NumShards];
+	};
+
+	struct ExploreResult
+	{
+		size_t NumStates = 0;
+		int NumLevels = 0;
+		bool bFoundTarget = false;
+		double Seconds = 0;
+	};
+
+	// "MI"에서 출발해 길이 MaxLength 이하의 상태를 모두 방문한다.
+	inline ExploreResult Explore(int MaxLength, VisitedSet& Visited, MuState Target = MuState::Make(1, 1),
+								 Parallel::ThreadPool& Pool = Parallel::ThreadPool::Shared())
+	{
+		EXPECTS(1 <= MaxLength && MaxLength <= MuState::MaxLength);
+		constexpr size_t ChunkSize = 1024;
+		const auto Start = std::chrono::steady_clock::now();
+
+		ExploreResult Result;
+		const MuState Axiom = MuState::Make(0, 1);
+		std::vector<MuState> Frontier {Axiom};
+		Visited.Insert(Axiom.Bits);
+		Result.NumStates = 1;
+
+		while (!Frontier.empty())
+		{
+			std::vector<std::vector<MuState>> Discovered((Frontier.size() + ChunkSize - 1) / ChunkSize);
+			Pool.ParallelFor(Frontier.size(), ChunkSize, [&] (size_t Begin, size_t End) {
+				std::vector<MuState>& Local = Discovered[Begin / ChunkSize];
+				for (size_t i = Begin; i < End; i++)
+				{
+					ForEachSuccessor(Frontier[i], MaxLength, [&] (MuState Next) {
+						if (Visited.Insert(Next.Bits)) Local.push_back(Next);
+					});
+				}
+			});
+
+			Frontier.clear();
+			for (auto& Local : Discovered)
+			{
+				for (MuState State : Local)
+				{
+					// I의 개수는 3의 배수가 되지 않는다. 그래서 MU(I가 0개)에는 도달할 수 없다.
+					INVARIANT(State.CountI() % 3 != 0);
+					Result.bFoundTarget = Result.bFoundTarget || State == Target;
+				}
+				Frontier.insert(Frontier.end(), Local.begin(), Local.end());
+			}
+			Result.NumStates += Frontier.size();
+			if (!Frontier.empty()) Result.NumLevels++;
+		}
+
+		Result.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+		return Result;
+	}
+
+	void TestExplorer()
+	{
+		MuState State;
+		const bool bParsed = MuState::Parse("MUIIU", State);
+		CHECK(bParsed && State.ToString() == "MUIIU" && State.CountI() == 2);
+		MuState Invalid;
+		const bool bParsedBadLetter = MuState::Parse("MIX", Invalid);
+		const bool bParsedNoM = MuState::Parse("IU", Invalid);
+		CHECK(!bParsedBadLetter && !bParsedNoM);
+
+		std::vector<std::string> Next;
+		MuState::Parse("MIIII", State);
+		ForEachSuccessor(State, 10, [&] (MuState S) { Next.push_back(S.ToString()); });
+		CHECK((Next == std::vector<std::string>{"MIIIIU", "MIIIIIIII", "MUI", "MIU"}));
+		Next.clear();
+		MuState::Parse("MUUU", State);
+		ForEachSuccessor(State, 10, [&] (MuState S) { Next.push_back(S.ToString()); });
+		CHECK((Next == std::vector<std::string>{"MUUUUUU", "MU", "MU"}));
+
+		// 문자열로 직접 규칙을 적용하는 단순한 BFS와 상태 수를 비교한다.
+		constexpr int MaxLength = 12;
+		std::vector<std::string> Queue {"MI"};
+		std::vector<std::string> Seen {"MI"};
+		auto Push = [&] (std::string Text) {
+			if (Text.size() - 1 > static_cast<size_t>(MaxLength)) return;
+			if (std::find(Seen.begin(), Seen.end(), Text) != Seen.end()) return;
+			Seen.push_back(Text);
+			Queue.push_back(Text);
+		};
+		for (size_t q = 0; q < Queue.size(); q++)
+		{
+			const std::string Text = Queue[q];
+			if (Text.back() == 'I') Push(Text + "U");
+			Push(Text + Text.substr(1));
+			for (size_t i = 1; i + 2 < Text.size(); i++)
+				if (Text.compare(i, 3, "III") == 0) Push(Text.substr(0, i) + "U" + Text.substr(i + 3));
+			for (size_t i = 1; i + 1 < Text.size(); i++)
+				if (Text.compare(i, 2, "UU") == 0) Push(Text.substr(0, i) + Text.substr(i + 2));
+		}
+
+		Parallel::ThreadPool Pool(3);
+		VisitedSet Visited;
+		const ExploreResult Result = Explore(MaxLength, Visited, MuState::Make(1, 1), Pool);
+		CHECK(Result.NumStates == Seen.size() && Visited.Size() == Seen.size());
+		CHECK(!Result.bFoundTarget);
+		for (const std::string& Text : Seen)
+		{
+			const bool bValid = MuState::Parse(Text, State);
+			CHECK(bValid && Visited.Contains(State.Bits));
+		}
+	}
+	REGISTER_TEST(TestExplorer, "Examples::MU_Puzzle::TestExplorer", TestExplorer);
+
+	void BenchmarkExplorer(int MaxLength = 24)
+	{
+		for (int Length = 8; Length <= MaxLength; Length += 4)
+		{
+			VisitedSet Visited;
+			const ExploreResult Result = Explore(Length, Visited);
+			std::cout << "MaxLength " << Length << ": " << Result.NumStates << " states in " << Result.NumLevels << " levels, "
+					  << Result.Seconds * 1000 << " ms, " << Result.NumStates / Result.Seconds << " states/s, MU "
+					  << (Result.bFoundTarget ? "reachable" : "unreachable") << std::endl;
+		}
+	}
+	REGISTER_BENCHMARK(BenchmarkExplorer, "Examples::MU_Puzzle::BenchmarkExplorer", [] { BenchmarkExplorer(); });
+}
@@ -0,0 +1,323 @@
+#pragma once
+
+// Fixed-size block pool for node-based containers.
+// container마다 NodePool을 하나 두고 node를 slab에서 잘라 쓴다.
+// 첫 slab은 작게(256B부터) 잡고 slab을 새로 받을 때마다 두 배로 키워 64KB에서 멈춘다.
+// 그래서 원소가 몇 개 없는 container가 많아도 container마다 64KB씩 차지하지 않는다.
+// 해제한 node는 pool의 free list로 돌아가서 다음 Allocate가 재사용한다.
+// pool이 파괴되면 node마다 free하지 않고 slab을 통째로 돌려준다.
+// 돌려받은 slab은 thread마다 있는 SlabCache에 크기별로 보관했다가 같은 thread의 다음 pool이 재사용한다.
+// 그래서 list를 만들고 없애기를 반복해도 malloc/free를 거의 호출하지 않는다.
+// thread가 끝나면서 SlabCache가 먼저 파괴된 뒤에 pool이 파괴되면(예: 더 늦게 파괴되는 thread_local/static container)
+// slab을 cache에 넣지 않고 바로 free한다.
+//
+// NodePool 하나를 여러 thread에서 동시에 쓰면 안된다(container와 같은 규칙).
+// Release는 destructor를 호출하지 않는다. 살아 있는 node가 trivially destructible이 아니라면
+// container가 먼저 Delete해야 한다.
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Registry.h"
+
+namespace Containers
+{
+	class SlabCache
+	{
+	public:
+		static constexpr size_t MinSlabBytes = 256;
+		static constexpr size_t SlabBytes = 64 * 1024;
+		static constexpr size_t MaxCachedBytes = 64 * SlabBytes;
+		static constexpr size_t NumSizeClasses = std::countr_zero(SlabBytes) - std::countr_zero(MinSlabBytes) + 1;
+
+		// 이 thread의 cache. 이미 파괴되었다면 nullptr이다.
+		static SlabCache* TryLocal()
+		{
+			thread_local SlabCache Cache;
+			return bAlive ? &Cache : nullptr;
+		}
+
+		static SlabCache& Local()
+		{
+			SlabCache* Cache = TryLocal();
+			assert(Cache);
+			return *Cache;
+		}
+
+		// Bytes는 MinSlabBytes와 SlabBytes 사이의 2의 거듭제곱이어야 한다.
+		static constexpr bool IsSlabSize(size_t Bytes)
+		{
+			return Bytes >= MinSlabBytes && Bytes <= SlabBytes && std::has_single_bit(Bytes);
+		}
+
+		static void* AcquireSlab(size_t Bytes)
+		{
+			if (SlabCache* Cache = TryLocal()) return Cache->Acquire(Bytes);
+			void* Slab = std::malloc(Bytes);
+			if (!Slab) throw std::bad_alloc();
+			return Slab;
+		}
+
+		static void RecycleSlab(void* Slab, size_t Bytes)
+		{
+			if (SlabCache* Cache = TryLocal()) Cache->Recycle(Slab, Bytes);
+			else std::free(Slab);
+		}
+
+		void* Acquire(size_t Bytes)
+		{
+			assert(IsSlabSize(Bytes));
+			FreeSlab*& Cached = FreeSlabs[ClassOf(Bytes)];
+			if (Cached)
+			{
+				FreeSlab* Slab = Cached;
+				Cached = Slab->Next;
+				CachedBytes -= Bytes;
+				return Slab;
+			}
+			NumMallocs++;
+			void* Slab = std::malloc(Bytes);
+			if (!Slab) throw std::bad_alloc();
+			return Slab;
+		}
+
+		void Recycle(void* Slab, size_t Bytes)
+		{
+			assert(IsSlabSize(Bytes));
+			if (CachedBytes + Bytes > MaxCachedBytes)
+			{
+				std::free(Slab);
+				return;
+			}
+			FreeSlab*& Cached = FreeSlabs[ClassOf(Bytes)];
+			Cached = ::new(Slab) FreeSlab{Cached};
+			CachedBytes += Bytes;
+		}
+
+		// 이 thread에서 slab을 malloc한 횟수.
+		size_t MallocCount() const { return NumMallocs; }
+
+		SlabCache() { bAlive = true; }
+		SlabCache(const SlabCache&) = delete;
+		SlabCache& operator=(const SlabCache&) = delete;
+		~SlabCache()
+		{
+			bAlive = false;
+			for (FreeSlab* Cached : FreeSlabs)
+			{
+				while (Cached)
+				{
+					FreeSlab* Next = Cached->Next;
+					std::free(Cached);
+					Cached = Next;
+				}
+			}
+		}
+
+	private:
+		struct FreeSlab { FreeSlab* Next; };
+
+		static constexpr size_t ClassOf(size_t Bytes) { return std::countr_zero(Bytes) - std::countr_zero(MinSlabBytes); }
+
+		// trivially destructible이라 thread가 끝나는 동안에도 읽을 수 있다.
+		static inline thread_local bool bAlive = false;
+		FreeSlab* FreeSlabs[NumSizeClasses] = {};
+		size_t CachedBytes = 0;
+		size_t NumMallocs = 0;
+	};
+
+	template<class T>
+	class NodePool
+	{
+		struct FreeNode { FreeNode* Next; };
+		struct SlabHeader { SlabHeader* Next; size_t Bytes; };
+
+		static constexpr size_t Align = alignof(T) > alignof(FreeNode) ? alignof(T) : alignof(FreeNode);
+		static constexpr size_t SlotSize = ((sizeof(T) > sizeof(FreeNode) ? sizeof(T) : sizeof(FreeNode)) + Align - 1) & ~(Align - 1);
+		static constexpr size_t FirstSlot = (sizeof(SlabHeader) + Align - 1) & ~(Align - 1);
+		static_assert(Align <= alignof(std::max_align_t), "malloc이 정렬을 보장하지 못한다.");
+		static_assert(FirstSlot + SlotSize <= SlabCache::SlabBytes, "node가 slab보다 크다.");
+
+		static constexpr size_t FirstSlabSize()
+		{
+			size_t Bytes = SlabCache::MinSlabBytes;
+			while (FirstSlot + SlotSize > Bytes) Bytes *= 2;
+			return Bytes;
+		}
+
+	public:
+		// 첫 slab의 크기. 다음 slab부터 SlabCache::SlabBytes까지 두 배씩 커진다.
+		static constexpr size_t FirstSlabBytes = FirstSlabSize();
+		static constexpr size_t NodesPerSlab(size_t Bytes) { return (Bytes - FirstSlot) / SlotSize; }
+
+		NodePool() = default;
+		NodePool(const NodePool&) = delete;
+		NodePool& operator=(const NodePool&) = delete;
+		NodePool(NodePool&& Other) noexcept { Swap(Other); }
+		NodePool& operator=(NodePool&& Other) noexcept
+		{
+			if (this != &Other)
+			{
+				Release();
+				Swap(Other);
+			}
+			return *this;
+		}
+		~NodePool() { Release(); }
+
+		void* Allocate()
+		{
+			NumLive++;
+			if (FreeList)
+			{
+				FreeNode* Node = FreeList;
+				FreeList = Node->Next;
+				return Node;
+			}
+			if (Bump == BumpEnd)
+			{
+				char* Slab = static_cast<char*>(SlabCache::AcquireSlab(NextSlabBytes));
+				Slabs = ::new(Slab) SlabHeader{Slabs, NextSlabBytes};
+				Bump = Slab + FirstSlot;
+				BumpEnd = Bump + NodesPerSlab(NextSlabBytes) * SlotSize;
+				NumSlabs++;
+				NumReservedBytes += NextSlabBytes;
+				NextSlabBytes = std::min(NextSlabBytes * 2, SlabCache::SlabBytes);
+			}
+			void* Node = Bump;
+			Bump += SlotSize;
+			return Node;
+		}
+
+		void Deallocate(void* Node)
+		{
+			assert(NumLive > 0);
+			NumLive--;
+			FreeList = ::new(Node) FreeNode{FreeList};
+		}
+
+		template<class... Args>
+		T* New(Args&&... InArgs)
+		{
+			void* Memory = Allocate();
+			try
+			{
+				return ::new(Memory) T(std::forward<Args>(InArgs)...);
+			}
+			catch (...)
+			{
+				Deallocate(Memory);
+				throw;
+			}
+		}
+
+		void Delete(T* Node)
+		{
+			Node->~T();
+			Deallocate(Node);
+		}
+
+		// 모든 slab을 한 번에 돌려준다.
+		void Release()
+		{
+			while (Slabs)
+			{
+				SlabHeader* Next = Slabs->Next;
+				SlabCache::RecycleSlab(Slabs, Slabs->Bytes);
+				Slabs = Next;
+			}
+			FreeList = nullptr;
+			Bump = BumpEnd = nullptr;
+			NumLive = NumSlabs = NumReservedBytes = 0;
+			NextSlabBytes = FirstSlabBytes;
+		}
+
+		size_t LiveCount() const { return NumLive; }
+		size_t SlabCount() const { return NumSlabs; }
+		// 지금 들고 있는 slab 크기의 합.
+		size_t ReservedBytes() const { return NumReservedBytes; }
+
+	private:
+		void Swap(NodePool& Other) noexcept
+		{
+			std::swap(Slabs, Other.Slabs);
+			std::swap(FreeList, Other.FreeList);
+			std::swap(Bump, Other.Bump);
+			std::swap(BumpEnd, Other.BumpEnd);
+			std::swap(NumLive, Other.NumLive);
+			std::swap(NumSlabs, Other.NumSlabs);
+			std::swap(NumReservedBytes, Other.NumReservedBytes);
+			std::swap(NextSlabBytes, Other.NextSlabBytes);
+		}
+
+		SlabHeader* Slabs = nullptr;
+		FreeNode* FreeList = nullptr;
+		char* Bump = nullptr;
+		char* BumpEnd = nullptr;
+		size_t NumLive = 0;
+		size_t NumSlabs = 0;
+		size_t NumReservedBytes = 0;
+		size_t NextSlabBytes = FirstSlabBytes;
+	};
+
+	void TestNodePool()
+	{
+		struct Node { int Value; Node* Next; };
+		{
+			NodePool<Node> Pool;
+			Node* Head = nullptr;
+			for (int i = 0; i < 10000; i++) Head = Pool.New(Node{i, Head});
+			CHECK(Pool.LiveCount() == 10000);
+			size_t ExpectedSlabs = 0, ExpectedBytes = 0;
+			for (size_t Capacity = 0, Bytes = NodePool<Node>::FirstSlabBytes; Capacity < 10000; Bytes = std::min(Bytes * 2, SlabCache::SlabBytes))
+			{
+				Capacity += NodePool<Node>::NodesPerSlab(Bytes);
+				ExpectedSlabs++;
+				ExpectedBytes += Bytes;
+			}
+			CHECK(Pool.SlabCount() == ExpectedSlabs);
+			CHECK(Pool.ReservedBytes() == ExpectedBytes);
+
+			Node* Second = Head->Next;
+			Pool.Delete(Head);
+			Node* Reused = Pool.New(Node{-1, Second});
+			CHECK(Reused == Head);  // free list를 먼저 재사용한다.
+		}
+		const size_t MallocsFirst = SlabCache::Local().MallocCount();
+		{
+			NodePool<Node> Pool;
+			for (int i = 0; i < 10000; i++) Pool.New(Node{i, nullptr});
+		}
+		// 두 번째 pool은 첫 pool이 돌려준 slab을 재사용한다.
+		CHECK(SlabCache::Local().MallocCount() == MallocsFirst);
+
+		// 원소가 하나뿐인 pool이 많아도 pool마다 첫 slab 하나만 차지한다.
+		{
+			constexpr size_t NumSmallPools = 10000;
+			std::vector<NodePool<Node>> SmallPools(NumSmallPools);
+			size_t TotalBytes = 0;
+			for (NodePool<Node>& Each : SmallPools)
+			{
+				Each.New(Node{0, nullptr});
+				TotalBytes += Each.ReservedBytes();
+			}
+			static_assert(NodePool<Node>::FirstSlabBytes == SlabCache::MinSlabBytes);
+			CHECK(TotalBytes == NumSmallPools * SlabCache::MinSlabBytes);
+		}
+
+		// SlabCache보다 먼저 생성되어 나중에 파괴되는 pool도 slab을 잃지 않고 free한다.
+		std::thread([] {
+			struct Holder { NodePool<Node> Pool; };
+			thread_local Holder Late;
+			Late.Pool.New(Node{1, nullptr});
+		}).join();
+	}
+	REGISTER_TEST(TestNodePool, "Containers::TestNodePool", TestNodePool);
+}
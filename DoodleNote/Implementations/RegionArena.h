@@ -0,0 +1,194 @@
+#pragma once
+
+// Region(arena) allocator.
+// 객체를 chunk 안에 차례로 쌓기만 하고(bump allocation) 하나씩 해제하지 않는다.
+// Reset이 만든 순서의 역순으로 소멸자를 한꺼번에 호출한 뒤 chunk를 처음부터 다시 쓴다.
+// trivially destructible 객체는 소멸자 기록을 남기지 않으므로 Reset 비용도 없다.
+// 객체 안에서 같은 Region으로 맴버를 할당하면 객체와 맴버가 연속된 메모리에 놓인다.
+//
+// Region 하나를 여러 thread에서 동시에 쓰면 안된다.
+// Region에 있는 객체를 delete하면 안되고, 소멸자는 예외를 던지지 않아야 한다.
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "Registry.h"
+
+namespace Memory
+{
+	class Region
+	{
+		struct Chunk
+		{
+			Chunk* Next;
+			size_t Size;
+		};
+
+		struct Finalizer
+		{
+			void (*Destroy)(void*);
+			void* Object;
+			Finalizer* Prev;
+		};
+
+	public:
+		static constexpr size_t DefaultChunkBytes = 64 * 1024;
+
+		explicit Region(size_t InChunkBytes = DefaultChunkBytes) : ChunkBytes(InChunkBytes) {}
+		Region(const Region&) = delete;
+		Region& operator=(const Region&) = delete;
+		~Region()
+		{
+			Reset();
+			while (Head)
+			{
+				Chunk* Next = Head->Next;
+				std::free(Head);
+				Head = Next;
+			}
+		}
+
+		void* Allocate(size_t Size, size_t Align = alignof(std::max_align_t))
+		{
+			assert(Align != 0 && (Align & (Align - 1)) == 0);
+			uintptr_t At = (Cursor + Align - 1) & ~(uintptr_t(Align) - 1);
+			if (!Current || At + Size > End)
+			{
+				NextChunk(Size + Align);
+				At = (Cursor + Align - 1) & ~(uintptr_t(Align) - 1);
+			}
+			Cursor = At + Size;
+			return reinterpret_cast<void*>(At);
+		}
+
+		template<class T, class... Args>
+		T* New(Args&&... InArgs)
+		{
+			void* Memory = Allocate(sizeof(T), alignof(T));
+			if constexpr (std::is_trivially_destructible_v<T>)
+			{
+				return ::new(Memory) T(std::forward<Args>(InArgs)...);
+			}
+			else
+			{
+				// 생성한 뒤에 Allocate가 던지면 소멸시킬 방법이 없으므로 기록할 자리를 먼저 잡는다.
+				// 생성이 끝난 뒤에 기록하므로, 생성자 안에서 만든 맴버는 이 객체보다 나중에 소멸된다.
+				void* Slot = Allocate(sizeof(Finalizer), alignof(Finalizer));
+				T* Object = ::new(Memory) T(std::forward<Args>(InArgs)...);
+				LastFinalizer = ::new(Slot) Finalizer{[] (void* Ptr) { static_cast<T*>(Ptr)->~T(); }, Object, LastFinalizer};
+				NumFinalizers++;
+				return Object;
+			}
+		}
+
+		// 모든 객체를 만든 순서의 역순으로 소멸시키고, chunk는 남겨 두어 다시 쓴다.
+		void Reset()
+		{
+			while (LastFinalizer)
+			{
+				Finalizer* Prev = LastFinalizer->Prev;
+				LastFinalizer->Destroy(LastFinalizer->Object);
+				LastFinalizer = Prev;
+			}
+			NumFinalizers = 0;
+			Current = Head;
+			Cursor = Head ? reinterpret_cast<uintptr_t>(Head + 1) : 0;
+			End = Head ? Cursor + Head->Size : 0;
+		}
+
+		size_t ChunkCount() const
+		{
+			size_t Count = 0;
+			for (Chunk* It = Head; It; It = It->Next) Count++;
+			return Count;
+		}
+		size_t FinalizerCount() const { return NumFinalizers; }
+
+	private:
+		// 다음 chunk로 넘어간다. Reset 전에 쓰던 chunk가 남아 있으면 재사용한다.
+		void NextChunk(size_t MinBytes)
+		{
+			while (Current && Current->Next)
+			{
+				Current = Current->Next;
+				if (Current->Size >= MinBytes)
+				{
+					Cursor = reinterpret_cast<uintptr_t>(Current + 1);
+					End = Cursor + Current->Size;
+					return;
+				}
+			}
+			const size_t Size = MinBytes > ChunkBytes ? MinBytes : ChunkBytes;
+			Chunk* NewChunk = static_cast<Chunk*>(std::malloc(sizeof(Chunk) + Size));
+			if (!NewChunk) throw std::bad_alloc();
+			NewChunk->Next = nullptr;
+			NewChunk->Size = Size;
+			if (Current) Current->Next = NewChunk;
+			else Head = NewChunk;
+			Current = NewChunk;
+			Cursor = reinterpret_cast<uintptr_t>(NewChunk + 1);
+			End = Cursor + Size;
+		}
+
+		size_t ChunkBytes;
+		Chunk* Head = nullptr;
+		Chunk* Current = nullptr;
+		uintptr_t Cursor = 0;
+		uintptr_t End = 0;
+		Finalizer* LastFinalizer = nullptr;
+		size_t NumFinalizers = 0;
+	};
+
+	void TestRegion()
+	{
+		struct Tracked
+		{
+			int Id;
+			int* Log;
+			int* LogSize;
+			~Tracked() { Log[(*LogSize)++] = Id; }
+		};
+		struct alignas(64) Wide { char Bytes[64]; };
+
+		int Log[8] = {};
+		int LogSize = 0;
+		Region Arena(1024);
+		for (int i = 0; i < 3; i++) Arena.New<Tracked>(i, Log, &LogSize);
+		for (int i = 0; i < 1000; i++) Arena.New<int>(i);
+		CHECK(Arena.FinalizerCount() == 3);  // int는 기록하지 않는다.
+
+		Wide* W = Arena.New<Wide>();
+		CHECK(reinterpret_cast<uintptr_t>(W) % 64 == 0);
+		std::string* Name = Arena.New<std::string>(100, 'x');
+		CHECK(Name->size() == 100 && Arena.FinalizerCount() == 4);
+
+		// 생성자가 던지면 기록하지 않으므로 Reset이 만들어지지 않은 객체를 소멸시키지 않는다.
+		struct Throwing
+		{
+			Throwing() { throw std::runtime_error("Throwing"); }
+			~Throwing() { std::abort(); }
+		};
+		bool bThrown = false;
+		try { Arena.New<Throwing>(); } catch (const std::runtime_error&) { bThrown = true; }
+		CHECK(bThrown && Arena.FinalizerCount() == 4);
+		char* Large = static_cast<char*>(Arena.Allocate(5000, 1));  // chunk보다 큰 할당
+		Large[4999] = 0;
+
+		const size_t Chunks = Arena.ChunkCount();
+		Arena.Reset();
+		CHECK(LogSize == 3 && Log[0] == 2 && Log[1] == 1 && Log[2] == 0);
+		CHECK(Arena.FinalizerCount() == 0);
+
+		// Reset 뒤에는 같은 chunk를 다시 쓴다.
+		for (int i = 0; i < 1000; i++) Arena.New<int>(i);
+		Arena.Allocate(5000, 1);
+		CHECK(Arena.ChunkCount() == Chunks);
+	}
+	REGISTER_TEST(TestRegion, "Memory::TestRegion", TestRegion);
+}
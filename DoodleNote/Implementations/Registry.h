@@ -0,0 +1,381 @@
+#pragma once
+
+// Test/benchmark registry and driver.
+// 각 header가 자기 Test와 Benchmark 함수를 이름과 함께 등록하고, main.cpp는 RunMain만 호출한다.
+//   REGISTER_TEST(Id, "Module::Name", Function);
+//   REGISTER_BENCHMARK(Id, "Module::Name", Function);
+// Id는 등록하는 namespace 안에서 유일한 identifier다. inline 변수로 등록하므로
+// header가 여러 translation unit에 포함되어도 한 번만 등록된다.
+// 이름은 "Module::Name" 꼴로 지어서 "Module::*"로 한 module을 고를 수 있게 한다.
+//
+// test는 assert 대신 CHECK(Condition)로 검사한다. CHECK는 NDEBUG와 무관하게 항상 평가되고,
+// 실패하면 위치를 담은 Registry::CheckFailure를 던지므로 driver는 그 항목만 실패로 기록하고 계속한다.
+// 조건식은 항상 평가되지만, 검사할 동작은 CHECK 밖에서 실행하고 결과만 검사하는 편이 읽기 쉽다.
+// CHECK는 항목을 실행하는 thread(또는 예외를 다시 던져 주는 ParallelFor의 body)에서만 쓴다.
+//
+// 사용법은 아래 Usage와 같다(--help로 출력한다).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Registry
+{
+	inline constexpr const char* Usage =
+		"usage: DoodleNote [options] [pattern...]\n"
+		"  pattern         glob over entry names ('*' matches any string). selects all if omitted.\n"
+		"  --list          print the names of the selected entries.\n"
+		"  --tests         run tests only (default).\n"
+		"  --benchmarks    run benchmarks only.\n"
+		"  --all           run both.\n"
+		"  --repeat=N      measure N runs (default 1).\n"
+		"  --warmup=N      run N times before measuring (default 0).\n"
+		"  --format=F      text (default), json or csv. json/csv hide entry output and print only results.\n"
+		"  --trace=PATH    trace the run and write Chrome trace JSON to PATH, one zone per entry.\n"
+		"  --help          print this message.\n"
+		"exit code: 0 if all entries passed, 1 if any failed, 2 on bad options or no matching entry.\n";
+
+	class CheckFailure : public std::runtime_error
+	{
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	[[noreturn]] inline void FailCheck(const char* Expression, const char* File, int Line)
+	{
+		throw CheckFailure(std::string(File) + ":" + std::to_string(Line) + ": CHECK(" + Expression + ") failed");
+	}
+
+	// test가 만드는 파일을 두는 임시 directory. temp_directory_path() 아래에 겹치지 않는 이름으로 만들고
+	// 소멸할 때 안의 파일과 함께 지우므로, 실행한 directory에 파일이 남지 않는다.
+	class ScratchDirectory
+	{
+	public:
+		ScratchDirectory()
+		{
+			static const uint64_t Token = (static_cast<uint64_t>(std::random_device{}()) << 32)
+				^ static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+			static std::atomic<uint64_t> Counter {0};
+			do
+			{
+				Root = std::filesystem::temp_directory_path() / ("DoodleNote-" + std::to_string(Token) + "-" + std::to_string(Counter++));
+			} while (!std::filesystem::create_directory(Root));
+		}
+		ScratchDirectory(const ScratchDirectory&) = delete;
+		ScratchDirectory& operator=(const ScratchDirectory&) = delete;
+		~ScratchDirectory()
+		{
+			std::error_code Error;
+			std::filesystem::remove_all(Root, Error);
+		}
+
+		std::string Path(std::string_view Name) const { return (Root / Name).string(); }
+
+	private:
+		std::filesystem::path Root;
+	};
+
+	enum class EEntryKind { Test, Benchmark };
+
+	struct Entry
+	{
+		std::string Name;
+		EEntryKind Kind;
+		void (*Function)();
+	};
+
+	inline std::vector<Entry>& Entries()
+	{
+		static std::vector<Entry> All;
+		return All;
+	}
+
+	struct Registrar
+	{
+		Registrar(const char* Name, EEntryKind Kind, void (*Function)())
+		{
+			Entries().push_back({Name, Kind, Function});
+		}
+	};
+
+	// --trace=PATH를 처리하는 쪽. Registry는 tracing에 의존하지 않고, Tracing.h가 TracerRegistrar로 등록한다.
+	struct Tracer
+	{
+		void (*Start)() = nullptr;
+		bool (*Finish)(const std::string& Path) = nullptr;  // 기록을 멈추고 Path에 쓴다.
+		uint64_t (*BeginZone)() = nullptr;
+		void (*EndZone)(const char* Name, uint64_t Begin) = nullptr;
+	};
+
+	inline Tracer& ActiveTracer()
+	{
+		static Tracer Current;
+		return Current;
+	}
+
+	struct TracerRegistrar
+	{
+		TracerRegistrar(const Tracer& InTracer) { ActiveTracer() = InTracer; }
+	};
+
+	struct Options
+	{
+		std::vector<std::string> Patterns;
+		bool bHelp = false;
+		bool bList = false;
+		bool bTests = true;
+		bool bBenchmarks = false;
+		int Repeat = 1;
+		int Warmup = 0;
+		std::string Format = "text";
+		std::string TracePath;
+	};
+
+	struct Result
+	{
+		const Entry* Target = nullptr;
+		std::vector<double> Milliseconds;
+		std::string Error;
+
+		// q번째 분위수(0..1). nearest-rank 방식이다.
+		double Quantile(double q) const
+		{
+			if (Milliseconds.empty()) return 0;
+			std::vector<double> Sorted = Milliseconds;
+			std::sort(Sorted.begin(), Sorted.end());
+			const size_t Rank = static_cast<size_t>(std::ceil(q * Sorted.size()));
+			return Sorted[std::clamp<size_t>(Rank, 1, Sorted.size()) - 1];
+		}
+		double Min() const { return Milliseconds.empty() ? 0 : *std::min_element(Milliseconds.begin(), Milliseconds.end()); }
+		double Median() const { return Quantile(0.5); }
+		double P99() const { return Quantile(0.99); }
+	};
+
+	// '*'만 지원하는 glob.
+	inline bool Matches(std::string_view Pattern, std::string_view Name)
+	{
+		size_t p = 0, n = 0, Star = std::string_view::npos, Resume = 0;
+		while (n < Name.size())
+		{
+			if (p < Pattern.size() && Pattern[p] == '*')
+			{
+				Star = p++;
+				Resume = n;
+			}
+			else if (p < Pattern.size() && Pattern[p] == Name[n])
+			{
+				p++;
+				n++;
+			}
+			else if (Star != std::string_view::npos)
+			{
+				p = Star + 1;
+				n = ++Resume;
+			}
+			else return false;
+		}
+		while (p < Pattern.size() && Pattern[p] == '*') p++;
+		return p == Pattern.size();
+	}
+
+	inline bool ParseOptions(int argc, char* argv[], Options& Out)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string_view Arg = argv[i];
+			auto Value = [&] (std::string_view Prefix, std::string_view& Rest) {
+				if (Arg.substr(0, Prefix.size()) != Prefix) return false;
+				Rest = Arg.substr(Prefix.size());
+				return true;
+			};
+			std::string_view Rest;
+			if (Arg == "--help" || Arg == "-h") Out.bHelp = true;
+			else if (Arg == "--list") Out.bList = true;
+			else if (Arg == "--tests") { Out.bTests = true; Out.bBenchmarks = false; }
+			else if (Arg == "--benchmarks") { Out.bTests = false; Out.bBenchmarks = true; }
+			else if (Arg == "--all") { Out.bTests = true; Out.bBenchmarks = true; }
+			else if (Value("--repeat=", Rest)) Out.Repeat = std::max(1, std::atoi(std::string(Rest).c_str()));
+			else if (Value("--warmup=", Rest)) Out.Warmup = std::max(0, std::atoi(std::string(Rest).c_str()));
+			else if (Value("--format=", Rest) && (Rest == "text" || Rest == "json" || Rest == "csv")) Out.Format = Rest;
+			else if (Value("--trace=", Rest) && !Rest.empty()) Out.TracePath = Rest;
+			else if (Arg.substr(0, 2) == "--")
+			{
+				std::cerr << "unknown option: " << Arg << "\n" << Usage;
+				return false;
+			}
+			else Out.Patterns.emplace_back(Arg);
+		}
+		return true;
+	}
+
+	inline std::vector<const Entry*> Select(const Options& Opts)
+	{
+		std::vector<const Entry*> Selected;
+		for (const Entry& Each : Entries())
+		{
+			if (Each.Kind == EEntryKind::Test ? !Opts.bTests : !Opts.bBenchmarks) continue;
+			const bool bMatched = Opts.Patterns.empty() ||
+				std::any_of(Opts.Patterns.begin(), Opts.Patterns.end(), [&] (const std::string& Pattern) { return Matches(Pattern, Each.Name); });
+			if (bMatched) Selected.push_back(&Each);
+		}
+		std::sort(Selected.begin(), Selected.end(), [] (const Entry* A, const Entry* B) { return A->Name < B->Name; });
+		return Selected;
+	}
+
+	inline Result Run(const Entry& Target, const Options& Opts)
+	{
+		Result Out;
+		Out.Target = &Target;
+		try
+		{
+			for (int i = 0; i < Opts.Warmup; i++) Target.Function();
+			for (int i = 0; i < Opts.Repeat; i++)
+			{
+				const auto Start = std::chrono::steady_clock::now();
+				Target.Function();
+				Out.Milliseconds.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count());
+			}
+		}
+		catch (const std::exception& Exception)
+		{
+			Out.Error = Exception.what();
+		}
+		catch (...)
+		{
+			Out.Error = "unknown exception";
+		}
+		return Out;
+	}
+
+	inline std::string Escape(std::string_view Text)
+	{
+		std::string Escaped;
+		for (char c : Text)
+		{
+			if (c == '"' || c == '\\') Escaped += '\\';
+			if (static_cast<unsigned char>(c) < 0x20) Escaped += ' ';
+			else Escaped += c;
+		}
+		return Escaped;
+	}
+
+	inline void Report(const std::vector<Result>& Results, const std::string& Format, std::ostream& Out)
+	{
+		auto Kind = [] (const Result& Each) { return Each.Target->Kind == EEntryKind::Test ? "test" : "benchmark"; };
+		if (Format == "json")
+		{
+			Out << "[\n";
+			for (size_t i = 0; i < Results.size(); i++)
+			{
+				const Result& Each = Results[i];
+				Out << "  {\"name\": \"" << Escape(Each.Target->Name) << "\", \"kind\": \"" << Kind(Each)
+					<< "\", \"status\": \"" << (Each.Error.empty() ? "ok" : "failed") << "\", \"runs\": " << Each.Milliseconds.size()
+					<< ", \"min_ms\": " << Each.Min() << ", \"median_ms\": " << Each.Median() << ", \"p99_ms\": " << Each.P99();
+				if (!Each.Error.empty()) Out << ", \"error\": \"" << Escape(Each.Error) << "\"";
+				Out << "}" << (i + 1 < Results.size() ? "," : "") << "\n";
+			}
+			Out << "]" << std::endl;
+		}
+		else if (Format == "csv")
+		{
+			Out << "name,kind,status,runs,min_ms,median_ms,p99_ms\n";
+			for (const Result& Each : Results)
+			{
+				Out << Each.Target->Name << "," << Kind(Each) << "," << (Each.Error.empty() ? "ok" : "failed") << ","
+					<< Each.Milliseconds.size() << "," << Each.Min() << "," << Each.Median() << "," << Each.P99() << "\n";
+			}
+			Out.flush();
+		}
+		else
+		{
+			for (const Result& Each : Results)
+			{
+				Out << (Each.Error.empty() ? "[  OK  ] " : "[FAILED] ") << Each.Target->Name << ": min " << Each.Min()
+					<< " ms, median " << Each.Median() << " ms, p99 " << Each.P99() << " ms (" << Each.Milliseconds.size() << " runs)";
+				if (!Each.Error.empty()) Out << " - " << Each.Error;
+				Out << "\n";
+			}
+			Out.flush();
+		}
+	}
+
+	inline int RunMain(int argc, char* argv[])
+	{
+		Options Opts;
+		if (!ParseOptions(argc, argv, Opts)) return 2;
+		if (Opts.bHelp)
+		{
+			std::cout << Usage;
+			return 0;
+		}
+		if (!Opts.TracePath.empty() && !ActiveTracer().Start)
+		{
+			std::cerr << "--trace needs Implementations/Tracing.h in the build" << std::endl;
+			return 2;
+		}
+		const std::vector<const Entry*> Selected = Select(Opts);
+		if (Opts.bList)
+		{
+			for (const Entry* Each : Selected)
+				std::cout << (Each->Kind == EEntryKind::Test ? "test      " : "benchmark ") << Each->Name << "\n";
+			return 0;
+		}
+		if (Selected.empty())
+		{
+			std::cerr << "no matching entries" << std::endl;
+			return 2;
+		}
+
+		// 기계가 읽을 출력이 섞이지 않도록 항목이 cout에 쓰는 것은 버린다.
+		std::ostringstream Discard;
+		std::streambuf* Original = Opts.Format == "text" ? nullptr : std::cout.rdbuf(Discard.rdbuf());
+
+		const Tracer& Trace = ActiveTracer();
+		const bool bTracing = !Opts.TracePath.empty();
+		if (bTracing) Trace.Start();
+		std::vector<Result> Results;
+		for (const Entry* Each : Selected)
+		{
+			if (!Original) std::cout << "=== " << Each->Name << " ===" << std::endl;
+			// Entries는 시작한 뒤로 바뀌지 않으므로 이름을 zone 이름으로 써도 된다.
+			const uint64_t ZoneBegin = bTracing ? Trace.BeginZone() : 0;
+			Results.push_back(Run(*Each, Opts));
+			if (bTracing) Trace.EndZone(Each->Name.c_str(), ZoneBegin);
+			Discard.str({});
+		}
+
+		if (Original) std::cout.rdbuf(Original);
+		else std::cout << std::endl;
+		Report(Results, Opts.Format, std::cout);
+
+		bool bFailed = std::any_of(Results.begin(), Results.end(), [] (const Result& Each) { return !Each.Error.empty(); });
+		if (bTracing)
+		{
+			if (!Trace.Finish(Opts.TracePath))
+			{
+				std::cerr << "cannot write trace: " << Opts.TracePath << std::endl;
+				bFailed = true;
+			}
+		}
+		return bFailed ? 1 : 0;
+	}
+}
+
+#define REGISTRY_DEFINE(Id, Name, Kind, Function) \
+	inline const ::Registry::Registrar RegistryEntry_##Id { Name, ::Registry::EEntryKind::Kind, Function }
+
+#define REGISTER_TEST(Id, Name, Function) REGISTRY_DEFINE(Id, Name, Test, Function)
+#define REGISTER_BENCHMARK(Id, Name, Function) REGISTRY_DEFINE(Id, Name, Benchmark, Function)
+
+#define CHECK(Condition) ((Condition) ? static_cast<void>(0) : ::Registry::FailCheck(#Condition, __FILE__, __LINE__))
@@ -0,0 +1,406 @@
+#pragma once
+
+// Vectorized kernels for contiguous int/float storage.
+// sum, scale(x *= a), multiply-add(y += a * x), 원소별 곱(out = a * b)을 SSE4.1/AVX2로 구현하고,
+// 실행 중에 CPU가 지원하는 가장 넓은 명령어 집합을 골라 쓴다. x86이 아니면 scalar만 쓴다.
+// float의 합은 여러 lane에 나누어 더하므로 순서대로 더한 scalar 결과와 반올림 오차가 다를 수 있다.
+// int 연산은 2의 보수 wrap-around로 계산하므로 모든 구현의 결과가 같다.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Registry.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SIMD_TARGET_SSE41
+#define SIMD_TARGET_AVX2
+#else
+#define SIMD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#else
+#define SIMD_X86 0
+#endif
+
+namespace Simd
+{
+	enum class EInstructionSet { Scalar, Sse41, Avx2 };
+
+	inline const char* ToString(EInstructionSet Set)
+	{
+		switch (Set)
+		{
+		case EInstructionSet::Sse41: return "SSE4.1";
+		case EInstructionSet::Avx2:  return "AVX2";
+		default:                     return "Scalar";
+		}
+	}
+
+	inline EInstructionSet DetectInstructionSet()
+	{
+#if SIMD_X86
+#ifdef _MSC_VER
+		int Info[4];
+		__cpuid(Info, 0);
+		const int MaxLeaf = Info[0];
+		__cpuid(Info, 1);
+		const bool bSse41 = Info[2] & (1 << 19);
+		const bool bFma = Info[2] & (1 << 12);
+		// OS가 AVX register를 저장/복원해 주는지도 확인해야 한다.
+		const bool bOsAvx = (Info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+		bool bAvx2 = false;
+		if (MaxLeaf >= 7)
+		{
+			__cpuidex(Info, 7, 0);
+			bAvx2 = Info[1] & (1 << 5);
+		}
+#else
+		__builtin_cpu_init();
+		const bool bSse41 = __builtin_cpu_supports("sse4.1");
+		const bool bFma = __builtin_cpu_supports("fma");
+		const bool bOsAvx = true; // __builtin_cpu_supports가 이미 확인한다.
+		const bool bAvx2 = __builtin_cpu_supports("avx2");
+#endif
+		if (bAvx2 && bFma && bOsAvx) return EInstructionSet::Avx2;
+		if (bSse41) return EInstructionSet::Sse41;
+#endif
+		return EInstructionSet::Scalar;
+	}
+
+	namespace Scalar
+	{
+		inline int Sum(const int* Data, size_t Size)
+		{
+			uint32_t Result = 0;
+			for (size_t i = 0; i < Size; i++) Result += static_cast<uint32_t>(Data[i]);
+			return static_cast<int>(Result);
+		}
+
+		inline float Sum(const float* Data, size_t Size)
+		{
+			float Result = 0.f;
+			for (size_t i = 0; i < Size; i++) Result += Data[i];
+			return Result;
+		}
+
+		inline void Scale(int* Data, size_t Size, int Factor)
+		{
+			for (size_t i = 0; i < Size; i++)
+				Data[i] = static_cast<int>(static_cast<uint32_t>(Data[i]) * static_cast<uint32_t>(Factor));
+		}
+
+		inline void Scale(float* Data, size_t Size, float Factor)
+		{
+			for (size_t i = 0; i < Size; i++) Data[i] *= Factor;
+		}
+
+		inline void MultiplyAdd(int* Y, const int* X, size_t Size, int A)
+		{
+			for (size_t i = 0; i < Size; i++)
+				Y[i] = static_cast<int>(static_cast<uint32_t>(Y[i]) + static_cast<uint32_t>(A) * static_cast<uint32_t>(X[i]));
+		}
+
+		inline void MultiplyAdd(float* Y, const float* X, size_t Size, float A)
+		{
+			for (size_t i = 0; i < Size; i++) Y[i] += A * X[i];
+		}
+
+		inline void Product(int* Out, const int* A, const int* B, size_t Size)
+		{
+			for (size_t i = 0; i < Size; i++)
+				Out[i] = static_cast<int>(static_cast<uint32_t>(A[i]) * static_cast<uint32_t>(B[i]));
+		}
+	}
+
+#if SIMD_X86
+	namespace Sse41
+	{
+		SIMD_TARGET_SSE41 inline int Sum(const int* Data, size_t Size)
+		{
+			__m128i Acc = _mm_setzero_si128();
+			size_t i = 0;
+			for (; i + 4 <= Size; i += 4)
+				Acc = _mm_add_epi32(Acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data + i)));
+			Acc = _mm_add_epi32(Acc, _mm_shuffle_epi32(Acc, _MM_SHUFFLE(1, 0, 3, 2)));
+			Acc = _mm_add_epi32(Acc, _mm_shuffle_epi32(Acc, _MM_SHUFFLE(2, 3, 0, 1)));
+			return static_cast<int>(static_cast<uint32_t>(_mm_cvtsi128_si32(Acc)) + static_cast<uint32_t>(Scalar::Sum(Data + i, Size - i)));
+		}
+
+		SIMD_TARGET_SSE41 inline float Sum(const float* Data, size_t Size)
+		{
+			__m128 Acc0 = _mm_setzero_ps();
+			__m128 Acc1 = _mm_setzero_ps();
+			size_t i = 0;
+			for (; i + 8 <= Size; i += 8)
+			{
+				Acc0 = _mm_add_ps(Acc0, _mm_loadu_ps(Data + i));
+				Acc1 = _mm_add_ps(Acc1, _mm_loadu_ps(Data + i + 4));
+			}
+			__m128 Acc = _mm_add_ps(Acc0, Acc1);
+			Acc = _mm_add_ps(Acc, _mm_movehl_ps(Acc, Acc));
+			Acc = _mm_add_ss(Acc, _mm_shuffle_ps(Acc, Acc, 1));
+			return _mm_cvtss_f32(Acc) + Scalar::Sum(Data + i, Size - i);
+		}
+
+		SIMD_TARGET_SSE41 inline void Scale(int* Data, size_t Size, int Factor)
+		{
+			const __m128i F = _mm_set1_epi32(Factor);
+			size_t i = 0;
+			for (; i + 4 <= Size; i += 4)
+			{
+				auto* At = reinterpret_cast<__m128i*>(Data + i);
+				_mm_storeu_si128(At, _mm_mullo_epi32(_mm_loadu_si128(At), F));
+			}
+			Scalar::Scale(Data + i, Size - i, Factor);
+		}
+
+		SIMD_TARGET_SSE41 inline void Scale(float* Data, size_t Size, float Factor)
+		{
+			const __m128 F = _mm_set1_ps(Factor);
+			size_t i = 0;
+			for (; i + 4 <= Size; i += 4)
+				_mm_storeu_ps(Data + i, _mm_mul_ps(_mm_loadu_ps(Data + i), F));
+			Scalar::Scale(Data + i, Size - i, Factor);
+		}
+
+		SIMD_TARGET_SSE41 inline void MultiplyAdd(int* Y, const int* X, size_t Size, int A)
+		{
+			const __m128i F = _mm_set1_epi32(A);
+			size_t i = 0;
+			for (; i + 4 <= Size; i += 4)
+			{
+				auto* At = reinterpret_cast<__m128i*>(Y + i);
+				const __m128i Product = _mm_mullo_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(X + i)), F);
+				_mm_storeu_si128(At, _mm_add_epi32(_mm_loadu_si128(At), Product));
+			}
+			Scalar::MultiplyAdd(Y + i, X + i, Size - i, A);
+		}
+
+		SIMD_TARGET_SSE41 inline void MultiplyAdd(float* Y, const float* X, size_t Size, float A)
+		{
+			const __m128 F = _mm_set1_ps(A);
+			size_t i = 0;
+			for (; i + 4 <= Size; i += 4)
+				_mm_storeu_ps(Y + i, _mm_add_ps(_mm_loadu_ps(Y + i), _mm_mul_ps(_mm_loadu_ps(X + i), F)));
+			Scalar::MultiplyAdd(Y + i, X + i, Size - i, A);
+		}
+
+		SIMD_TARGET_SSE41 inline void Product(int* Out, const int* A, const int* B, size_t Size)
+		{
+			size_t i = 0;
+			for (; i + 4 <= Size; i += 4)
+			{
+				const __m128i Left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(A + i));
+				const __m128i Right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(B + i));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(Out + i), _mm_mullo_epi32(Left, Right));
+			}
+			Scalar::Product(Out + i, A + i, B + i, Size - i);
+		}
+	}
+
+	namespace Avx2
+	{
+		SIMD_TARGET_AVX2 inline int Sum(const int* Data, size_t Size)
+		{
+			__m256i Acc = _mm256_setzero_si256();
+			size_t i = 0;
+			for (; i + 8 <= Size; i += 8)
+				Acc = _mm256_add_epi32(Acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Data + i)));
+			__m128i Half = _mm_add_epi32(_mm256_castsi256_si128(Acc), _mm256_extracti128_si256(Acc, 1));
+			Half = _mm_add_epi32(Half, _mm_shuffle_epi32(Half, _MM_SHUFFLE(1, 0, 3, 2)));
+			Half = _mm_add_epi32(Half, _mm_shuffle_epi32(Half, _MM_SHUFFLE(2, 3, 0, 1)));
+			return static_cast<int>(static_cast<uint32_t>(_mm_cvtsi128_si32(Half)) + static_cast<uint32_t>(Scalar::Sum(Data + i, Size - i)));
+		}
+
+		SIMD_TARGET_AVX2 inline float Sum(const float* Data, size_t Size)
+		{
+			__m256 Acc0 = _mm256_setzero_ps();
+			__m256 Acc1 = _mm256_setzero_ps();
+			size_t i = 0;
+			for (; i + 16 <= Size; i += 16)
+			{
+				Acc0 = _mm256_add_ps(Acc0, _mm256_loadu_ps(Data + i));
+				Acc1 = _mm256_add_ps(Acc1, _mm256_loadu_ps(Data + i + 8));
+			}
+			const __m256 Acc = _mm256_add_ps(Acc0, Acc1);
+			__m128 Half = _mm_add_ps(_mm256_castps256_ps128(Acc), _mm256_extractf128_ps(Acc, 1));
+			Half = _mm_add_ps(Half, _mm_movehl_ps(Half, Half));
+			Half = _mm_add_ss(Half, _mm_shuffle_ps(Half, Half, 1));
+			return _mm_cvtss_f32(Half) + Scalar::Sum(Data + i, Size - i);
+		}
+
+		SIMD_TARGET_AVX2 inline void Scale(int* Data, size_t Size, int Factor)
+		{
+			const __m256i F = _mm256_set1_epi32(Factor);
+			size_t i = 0;
+			for (; i + 8 <= Size; i += 8)
+			{
+				auto* At = reinterpret_cast<__m256i*>(Data + i);
+				_mm256_storeu_si256(At, _mm256_mullo_epi32(_mm256_loadu_si256(At), F));
+			}
+			Scalar::Scale(Data + i, Size - i, Factor);
+		}
+
+		SIMD_TARGET_AVX2 inline void Scale(float* Data, size_t Size, float Factor)
+		{
+			const __m256 F = _mm256_set1_ps(Factor);
+			size_t i = 0;
+			for (; i + 8 <= Size; i += 8)
+				_mm256_storeu_ps(Data + i, _mm256_mul_ps(_mm256_loadu_ps(Data + i), F));
+			Scalar::Scale(Data + i, Size - i, Factor);
+		}
+
+		SIMD_TARGET_AVX2 inline void MultiplyAdd(int* Y, const int* X, size_t Size, int A)
+		{
+			const __m256i F = _mm256_set1_epi32(A);
+			size_t i = 0;
+			for (; i + 8 <= Size; i += 8)
+			{
+				auto* At = reinterpret_cast<__m256i*>(Y + i);
+				const __m256i Product = _mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(X + i)), F);
+				_mm256_storeu_si256(At, _mm256_add_epi32(_mm256_loadu_si256(At), Product));
+			}
+			Scalar::MultiplyAdd(Y + i, X + i, Size - i, A);
+		}
+
+		SIMD_TARGET_AVX2 inline void MultiplyAdd(float* Y, const float* X, size_t Size, float A)
+		{
+			const __m256 F = _mm256_set1_ps(A);
+			size_t i = 0;
+			for (; i + 8 <= Size; i += 8)
+				_mm256_storeu_ps(Y + i, _mm256_fmadd_ps(_mm256_loadu_ps(X + i), F, _mm256_loadu_ps(Y + i)));
+			Scalar::MultiplyAdd(Y + i, X + i, Size - i, A);
+		}
+
+		SIMD_TARGET_AVX2 inline void Product(int* Out, const int* A, const int* B, size_t Size)
+		{
+			size_t i = 0;
+			for (; i + 8 <= Size; i += 8)
+			{
+				const __m256i Left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(A + i));
+				const __m256i Right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(B + i));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(Out + i), _mm256_mullo_epi32(Left, Right));
+			}
+			Scalar::Product(Out + i, A + i, B + i, Size - i);
+		}
+	}
+#endif
+
+	struct KernelTable
+	{
+		EInstructionSet Set;
+		int   (*SumInt)(const int*, size_t);
+		float (*SumFloat)(const float*, size_t);
+		void  (*ScaleInt)(int*, size_t, int);
+		void  (*ScaleFloat)(float*, size_t, float);
+		void  (*MultiplyAddInt)(int*, const int*, size_t, int);
+		void  (*MultiplyAddFloat)(float*, const float*, size_t, float);
+		void  (*ProductInt)(int*, const int*, const int*, size_t);
+	};
+
+#define SIMD_KERNEL_TABLE(Set, Namespace) KernelTable{ Set, \
+	Namespace::Sum, Namespace::Sum, Namespace::Scale, Namespace::Scale, Namespace::MultiplyAdd, Namespace::MultiplyAdd, Namespace::Product }
+
+	// 지원하지 않는 명령어 집합을 요청하면 scalar를 돌려준다.
+	inline KernelTable SelectKernels(EInstructionSet Set)
+	{
+#if SIMD_X86
+		if (Set == EInstructionSet::Avx2 && DetectInstructionSet() == EInstructionSet::Avx2)
+			return SIMD_KERNEL_TABLE(EInstructionSet::Avx2, Avx2);
+		if (Set != EInstructionSet::Scalar && DetectInstructionSet() != EInstructionSet::Scalar)
+			return SIMD_KERNEL_TABLE(EInstructionSet::Sse41, Sse41);
+#endif
+		(void)Set;
+		return SIMD_KERNEL_TABLE(EInstructionSet::Scalar, Scalar);
+	}
+
+#undef SIMD_KERNEL_TABLE
+
+	// 처음 호출할 때 한 번만 CPU를 검사한다.
+	inline const KernelTable& Kernels()
+	{
+		static const KernelTable Table = SelectKernels(DetectInstructionSet());
+		return Table;
+	}
+
+	inline int   Sum(const int* Data, size_t Size)                     { return Kernels().SumInt(Data, Size); }
+	inline float Sum(const float* Data, size_t Size)                   { return Kernels().SumFloat(Data, Size); }
+	inline void  Scale(int* Data, size_t Size, int Factor)             { Kernels().ScaleInt(Data, Size, Factor); }
+	inline void  Scale(float* Data, size_t Size, float Factor)         { Kernels().ScaleFloat(Data, Size, Factor); }
+	inline void  MultiplyAdd(int* Y, const int* X, size_t Size, int A)       { Kernels().MultiplyAddInt(Y, X, Size, A); }
+	inline void  MultiplyAdd(float* Y, const float* X, size_t Size, float A) { Kernels().MultiplyAddFloat(Y, X, Size, A); }
+	inline void  Product(int* Out, const int* A, const int* B, size_t Size)  { Kernels().ProductInt(Out, A, B, Size); }
+
+	// 이 CPU가 지원하는 명령어 집합마다 모든 kernel의 결과를 scalar와 비교한다.
+	// 길이는 vector 폭보다 짧은 경우와 나머지(tail)가 남는 경우를 고른다.
+	// int는 정확히 같아야 하고, float는 lane별로 더하거나 FMA를 쓰므로 오차를 허용한다.
+	inline void TestSimdKernels()
+	{
+		const KernelTable Reference = SelectKernels(EInstructionSet::Scalar);
+		const EInstructionSet Supported = DetectInstructionSet();
+
+		uint32_t Seed = 12345;
+		auto NextInt = [&] { Seed = Seed * 1664525u + 1013904223u; return static_cast<int>(Seed); };
+		auto NextFloat = [&] { return static_cast<float>(NextInt() % 2001) / 100.f - 10.f; };
+		auto Near = [] (float A, float B, float Magnitude) { return std::fabs(A - B) <= 1e-5f * (1.f + Magnitude); };
+
+		for (EInstructionSet Set : {EInstructionSet::Sse41, EInstructionSet::Avx2})
+		{
+			if (Supported < Set) continue;
+			const KernelTable Tested = SelectKernels(Set);
+			CHECK(Tested.Set == Set);
+
+			for (size_t Size : {0, 1, 7, 9, 33})
+			{
+				std::vector<int> Ints(Size), OtherInts(Size);
+				std::vector<float> Floats(Size), OtherFloats(Size);
+				float Magnitude = 0.f;
+				for (size_t i = 0; i < Size; i++)
+				{
+					// 곱하면 overflow가 나도록 큰 값도 섞는다.
+					Ints[i] = NextInt();
+					OtherInts[i] = NextInt() % 1000;
+					Floats[i] = NextFloat();
+					OtherFloats[i] = NextFloat();
+					Magnitude += std::fabs(Floats[i]) * 20.f;
+				}
+
+				CHECK(Tested.SumInt(Ints.data(), Size) == Reference.SumInt(Ints.data(), Size));
+				CHECK(Near(Tested.SumFloat(Floats.data(), Size), Reference.SumFloat(Floats.data(), Size), Magnitude));
+
+				std::vector<int> ExpectedInts = Ints, ActualInts = Ints;
+				Reference.ScaleInt(ExpectedInts.data(), Size, -7919);
+				Tested.ScaleInt(ActualInts.data(), Size, -7919);
+				CHECK(ActualInts == ExpectedInts);
+
+				ExpectedInts = ActualInts = Ints;
+				Reference.MultiplyAddInt(ExpectedInts.data(), OtherInts.data(), Size, 104729);
+				Tested.MultiplyAddInt(ActualInts.data(), OtherInts.data(), Size, 104729);
+				CHECK(ActualInts == ExpectedInts);
+
+				Reference.ProductInt(ExpectedInts.data(), Ints.data(), OtherInts.data(), Size);
+				Tested.ProductInt(ActualInts.data(), Ints.data(), OtherInts.data(), Size);
+				CHECK(ActualInts == ExpectedInts);
+
+				std::vector<float> ExpectedFloats = Floats, ActualFloats = Floats;
+				Reference.ScaleFloat(ExpectedFloats.data(), Size, 1.5f);
+				Tested.ScaleFloat(ActualFloats.data(), Size, 1.5f);
+				for (size_t i = 0; i < Size; i++)
+					CHECK(Near(ActualFloats[i], ExpectedFloats[i], std::fabs(ExpectedFloats[i])));
+
+				ExpectedFloats = ActualFloats = Floats;
+				Reference.MultiplyAddFloat(ExpectedFloats.data(), OtherFloats.data(), Size, -0.25f);
+				Tested.MultiplyAddFloat(ActualFloats.data(), OtherFloats.data(), Size, -0.25f);
+				for (size_t i = 0; i < Size; i++)
+					CHECK(Near(ActualFloats[i], ExpectedFloats[i], std::fabs(Floats[i]) + std::fabs(OtherFloats[i])));
+			}
+		}
+	}
+	REGISTER_TEST(TestSimdKernels, "Simd::TestSimdKernels", TestSimdKernels);
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+// Growable array with an inline small buffer.
+// InlineCapacity개 이하의 원소는 객체 안의 buffer에 두므로 heap을 전혀 쓰지 않는다.
+// 넘치면 capacity를 두 배씩 늘린다(필요한 크기가 더 크면 그 크기로).
+// trivially copyable 원소는 heap에 있는 block을 realloc으로 늘리고, inline buffer에서 옮길 때는 memcpy를 쓴다.
+// 그 외의 원소는 새 block에 move 생성한 뒤 이전 원소를 파괴한다.
+// 할당에 실패하면 std::bad_alloc을 던지며 배열은 그대로 남는다.
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "Registry.h"
+
+namespace Containers
+{
+	template<class T, size_t InlineCapacity = 16>
+	class SmallArray
+	{
+		static_assert(alignof(T) <= alignof(std::max_align_t), "malloc이 정렬을 보장하지 못한다.");
+		static constexpr bool bRelocatable = std::is_trivially_copyable_v<T>;
+
+	public:
+		using value_type = T;
+		using iterator = T*;
+		using const_iterator = const T*;
+
+		SmallArray() = default;
+		SmallArray(std::initializer_list<T> Init) { Append(std::span<const T>(Init.begin(), Init.size())); }
+		SmallArray(const SmallArray& Other) { Append(std::span<const T>(Other.data(), Other.size())); }
+		SmallArray(SmallArray&& Other) noexcept(std::is_nothrow_move_constructible_v<T>) { MoveFrom(Other); }
+		~SmallArray()
+		{
+			clear();
+			if (!IsInline()) std::free(Datas);
+		}
+
+		SmallArray& operator=(const SmallArray& Other)
+		{
+			if (this != &Other)
+			{
+				clear();
+				Append(std::span<const T>(Other.data(), Other.size()));
+			}
+			return *this;
+		}
+
+		SmallArray& operator=(SmallArray&& Other) noexcept(std::is_nothrow_move_constructible_v<T>)
+		{
+			if (this != &Other)
+			{
+				clear();
+				if (!IsInline()) std::free(Datas);
+				Datas = InlineData();
+				Capacity = InlineCapacity;
+				MoveFrom(Other);
+			}
+			return *this;
+		}
+
+		size_t size() const { return Length; }
+		size_t capacity() const { return Capacity; }
+		bool empty() const { return Length == 0; }
+		T* data() { return Datas; }
+		const T* data() const { return Datas; }
+		iterator begin() { return Datas; }
+		iterator end() { return Datas + Length; }
+		const_iterator begin() const { return Datas; }
+		const_iterator end() const { return Datas + Length; }
+
+		T& operator[](size_t i)
+		{
+			assert(i < Length);
+			return Datas[i];
+		}
+		const T& operator[](size_t i) const
+		{
+			assert(i < Length);
+			return Datas[i];
+		}
+
+		// heap에서 block을 할당한 횟수. inline buffer만 쓰면 0이다.
+		size_t AllocationCount() const { return NumAllocations; }
+		bool IsInline() const { return Datas == InlineData(); }
+
+		void reserve(size_t NewCapacity)
+		{
+			if (NewCapacity > Capacity) Grow(NewCapacity);
+		}
+
+		template<class... Args>
+		T& emplace_back(Args&&... InArgs)
+		{
+			if (Length == Capacity)
+			{
+				// InArgs가 이 배열의 원소를 가리킬 수 있으므로 먼저 만들어 둔다.
+				T Temp(std::forward<Args>(InArgs)...);
+				Grow(NextCapacity(Length + 1));
+				return *::new(static_cast<void*>(Datas + Length++)) T(std::move(Temp));
+			}
+			return *::new(static_cast<void*>(Datas + Length++)) T(std::forward<Args>(InArgs)...);
+		}
+
+		void push_back(const T& Value) { emplace_back(Value); }
+		void push_back(T&& Value) { emplace_back(std::move(Value)); }
+
+		// 한 번만 늘리고 이어 붙인다. Values가 이 배열 안을 가리켜도 된다.
+		void Append(std::span<const T> Values)
+		{
+			if (Values.empty()) return;
+			if (Length + Values.size() > Capacity)
+			{
+				if (Values.data() >= Datas && Values.data() < Datas + Length)
+				{
+					SmallArray Copy;
+					Copy.Append(Values);
+					Append(std::span<const T>(Copy.data(), Copy.size()));
+					return;
+				}
+				Grow(NextCapacity(Length + Values.size()));
+			}
+			if constexpr (bRelocatable)
+			{
+				std::memcpy(static_cast<void*>(Datas + Length), Values.data(), Values.size() * sizeof(T));
+			}
+			else
+			{
+				std::uninitialized_copy(Values.begin(), Values.end(), Datas + Length);
+			}
+			Length += Values.size();
+		}
+
+		void pop_back()
+		{
+			assert(Length > 0);
+			std::destroy_at(Datas + --Length);
+		}
+
+		void clear()
+		{
+			std::destroy(Datas, Datas + Length);
+			Length = 0;
+		}
+
+	private:
+		T* InlineData() { return std::launder(reinterpret_cast<T*>(InlineBuffer)); }
+		const T* InlineData() const { return std::launder(reinterpret_cast<const T*>(InlineBuffer)); }
+
+		size_t NextCapacity(size_t Required) const
+		{
+			return std::max(Required, Capacity * 2);
+		}
+
+		void Grow(size_t NewCapacity)
+		{
+			if (NewCapacity > SIZE_MAX / sizeof(T)) throw std::bad_alloc();
+			T* NewDatas;
+			if constexpr (bRelocatable)
+			{
+				if (!IsInline())
+				{
+					NewDatas = static_cast<T*>(std::realloc(Datas, NewCapacity * sizeof(T)));
+					if (!NewDatas) throw std::bad_alloc();
+				}
+				else
+				{
+					NewDatas = static_cast<T*>(std::malloc(NewCapacity * sizeof(T)));
+					if (!NewDatas) throw std::bad_alloc();
+					std::memcpy(static_cast<void*>(NewDatas), Datas, Length * sizeof(T));
+				}
+			}
+			else
+			{
+				NewDatas = static_cast<T*>(std::malloc(NewCapacity * sizeof(T)));
+				if (!NewDatas) throw std::bad_alloc();
+				try
+				{
+					std::uninitialized_move(Datas, Datas + Length, NewDatas);
+				}
+				catch (...)
+				{
+					std::free(NewDatas);
+					throw;
+				}
+				std::destroy(Datas, Datas + Length);
+				if (!IsInline()) std::free(Datas);
+			}
+			Datas = NewDatas;
+			Capacity = NewCapacity;
+			NumAllocations++;
+		}
+
+		// 이 배열은 비어 있고 inline buffer를 쓰고 있어야 한다.
+		void MoveFrom(SmallArray& Other)
+		{
+			if (Other.IsInline())
+			{
+				std::uninitialized_move(Other.Datas, Other.Datas + Other.Length, Datas);
+				Length = Other.Length;
+				Other.clear();
+			}
+			else
+			{
+				// heap block은 통째로 넘겨받는다.
+				Datas = Other.Datas;
+				Length = Other.Length;
+				Capacity = Other.Capacity;
+				Other.Datas = Other.InlineData();
+				Other.Length = 0;
+				Other.Capacity = InlineCapacity;
+			}
+		}
+
+		alignas(T) unsigned char InlineBuffer[InlineCapacity * sizeof(T)];
+		T* Datas = InlineData();
+		size_t Length = 0;
+		size_t Capacity = InlineCapacity;
+		size_t NumAllocations = 0;
+	};
+
+	void TestSmallArray()
+	{
+		SmallArray<int, 4> Small;
+		for (int i = 0; i < 4; i++) Small.push_back(i);
+		CHECK(Small.IsInline() && Small.AllocationCount() == 0);
+		Small.push_back(4);
+		CHECK(!Small.IsInline() && Small.capacity() == 8);
+		Small.Append(std::span<const int>(Small.data(), Small.size()));
+		CHECK(Small.size() == 10 && Small[9] == 4);
+		Small.reserve(100);
+		CHECK(Small.capacity() == 100 && Small[5] == 0);
+
+		SmallArray<std::string, 2> Strings;
+		for (int i = 0; i < 50; i++) Strings.emplace_back(std::to_string(i) + std::string(20, 'x'));
+		Strings.push_back(Strings[0]);
+		CHECK(Strings.size() == 51 && Strings[50] == Strings[0]);
+
+		SmallArray<std::string, 2> Copied = Strings;
+		SmallArray<std::string, 2> Moved = std::move(Strings);
+		CHECK(Copied.size() == 51 && Moved.size() == 51 && Strings.empty() && Strings.IsInline());
+		CHECK(std::equal(Copied.begin(), Copied.end(), Moved.begin()));
+
+		SmallArray<std::string, 2> Inline{"a", "b"};
+		Moved = std::move(Inline);
+		CHECK(Moved.size() == 2 && Moved[1] == "b" && Moved.IsInline());
+	}
+	REGISTER_TEST(TestSmallArray, "Containers::TestSmallArray", TestSmallArray);
+}
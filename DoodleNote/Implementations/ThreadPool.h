@@ -0,0 +1,272 @@
+#pragma once
+
+// Persistent work-stealing thread pool.
+// worker thread는 처음에 한 번 만들고 계속 재사용한다.
+// worker마다 자기 deque가 있어서, 자기 deque는 뒤에서 꺼내고 비면 다른 worker의 deque 앞에서 훔쳐온다.
+// ParallelFor를 호출한 thread도 일이 끝날 때까지 task를 함께 실행하므로, worker가 없는 1-core 환경에서도 동작한다.
+//
+// ParallelReduce는 구간을 thread 수와 무관하게 ChunkSize 단위로 나누고, 각 chunk의 부분 결과를
+// chunk 순서대로 합친다. 따라서 float 합처럼 결합 순서에 따라 반올림이 달라지는 연산도
+// 같은 기계에서는 실행할 때마다 같은 결과를 낸다.
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Registry.h"
+
+namespace Parallel
+{
+	// 한 번에 처리할 구간의 byte 크기. L2 cache에 충분히 들어가는 크기다.
+	inline constexpr size_t ChunkBytes = 64 * 1024;
+
+	class ThreadPool
+	{
+	public:
+		// NumWorkers가 0이면 hardware thread 수 - 1개를 만든다(호출한 thread가 나머지 하나를 맡는다).
+		explicit ThreadPool(size_t NumWorkers = 0)
+		{
+			if (NumWorkers == 0) NumWorkers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+			// 마지막 queue는 worker가 아닌 thread가 넣는 task를 받는다.
+			for (size_t i = 0; i <= NumWorkers; i++) Queues.push_back(std::make_unique<WorkQueue>());
+			for (size_t i = 0; i < NumWorkers; i++) Workers.emplace_back([this, i] { WorkerLoop(i); });
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		~ThreadPool()
+		{
+			{
+				std::lock_guard Lock(SleepMutex);
+				bStop = true;
+			}
+			WakeUp.notify_all();
+			for (auto& Worker : Workers) Worker.join();
+		}
+
+		static ThreadPool& Shared()
+		{
+			static ThreadPool Pool;
+			return Pool;
+		}
+
+		size_t WorkerCount() const { return Workers.size(); }
+
+		// [0, Count)를 ChunkSize개씩 나누어 Body(Begin, End)를 병렬로 실행하고, 모두 끝나면 돌아온다.
+		// Body가 던진 첫 예외를 호출한 thread에서 다시 던진다.
+		template<class BodyType>
+		void ParallelFor(size_t Count, size_t ChunkSize, BodyType&& Body)
+		{
+			if (Count == 0) return;
+			ChunkSize = std::max<size_t>(ChunkSize, 1);
+			const size_t NumChunks = (Count + ChunkSize - 1) / ChunkSize;
+			if (NumChunks == 1 || Workers.empty())
+			{
+				for (size_t Begin = 0; Begin < Count; Begin += ChunkSize) Body(Begin, std::min(Count, Begin + ChunkSize));
+				return;
+			}
+
+			struct Context
+			{
+				BodyType* Body;
+				size_t Count;
+				size_t ChunkSize;
+				Batch State;
+			} Ctx{&Body, Count, ChunkSize, {}};
+			Ctx.State.Remaining.store(NumChunks, std::memory_order_relaxed);
+
+			auto Run = [] (void* Opaque, size_t Chunk) {
+				auto& Self = *static_cast<Context*>(Opaque);
+				const size_t Begin = Chunk * Self.ChunkSize;
+				(*Self.Body)(Begin, std::min(Self.Count, Begin + Self.ChunkSize));
+			};
+
+			// task를 넣기 전에 늘려 두어야 먼저 꺼낸 worker가 0 아래로 줄이지 않는다.
+			NumQueued.fetch_add(NumChunks, std::memory_order_relaxed);
+
+			// chunk를 queue마다 연속된 묶음으로 나누어 넣는다. 이웃한 chunk가 같은 thread에서 돌 가능성이 높다.
+			const size_t NumQueues = Queues.size();
+			for (size_t q = 0; q < NumQueues; q++)
+			{
+				const size_t First = NumChunks * q / NumQueues;
+				const size_t Last = NumChunks * (q + 1) / NumQueues;
+				if (First == Last) continue;
+				std::lock_guard Lock(Queues[q]->Mutex);
+				for (size_t Chunk = First; Chunk < Last; Chunk++) Queues[q]->Tasks.push_back({Run, &Ctx, Chunk, &Ctx.State});
+			}
+			{
+				// 잠들기 직전의 worker가 알림을 놓치지 않도록 SleepMutex를 거친다.
+				std::lock_guard Lock(SleepMutex);
+			}
+			WakeUp.notify_all();
+
+			// 기다리는 동안 task를 함께 실행한다.
+			// 다른 pool의 worker가 호출했다면 그 index는 이 pool과 상관없으므로 공용 queue를 쓴다.
+			const size_t Home = LocalPool == this ? static_cast<size_t>(LocalIndex) : NumQueues - 1;
+			while (Ctx.State.Remaining.load(std::memory_order_acquire) != 0)
+			{
+				if (!RunOne(Home)) std::this_thread::yield();
+			}
+			if (Ctx.State.Error) std::rethrow_exception(Ctx.State.Error);
+		}
+
+		// 구간을 chunk로 나누어 ChunkReduce(Begin, End)로 부분 결과를 구하고, chunk 순서대로 Combine한다.
+		template<class ValueType, class ChunkReduceType, class CombineType>
+		ValueType ParallelReduce(size_t Count, size_t ChunkSize, ValueType Init, ChunkReduceType&& ChunkReduce, CombineType&& Combine)
+		{
+			ChunkSize = std::max<size_t>(ChunkSize, 1);
+			std::vector<ValueType> Partials((Count + ChunkSize - 1) / ChunkSize, Init);
+			ParallelFor(Count, ChunkSize, [&] (size_t Begin, size_t End) {
+				Partials[Begin / ChunkSize] = ChunkReduce(Begin, End);
+			});
+			for (auto& Partial : Partials) Init = Combine(std::move(Init), std::move(Partial));
+			return Init;
+		}
+
+	private:
+		struct Batch
+		{
+			std::atomic<size_t> Remaining {0};
+			std::mutex ErrorMutex;
+			std::exception_ptr Error;
+		};
+
+		struct Task
+		{
+			void (*Run)(void*, size_t);
+			void* Context;
+			size_t Chunk;
+			Batch* Owner;
+		};
+
+		struct WorkQueue
+		{
+			std::mutex Mutex;
+			std::deque<Task> Tasks;
+		};
+
+		// 자기 queue의 뒤, 아니면 다른 queue의 앞에서 task 하나를 꺼내 실행한다.
+		bool RunOne(size_t Home)
+		{
+			Task Current;
+			bool bFound = false;
+			{
+				std::lock_guard Lock(Queues[Home]->Mutex);
+				if (!Queues[Home]->Tasks.empty())
+				{
+					Current = Queues[Home]->Tasks.back();
+					Queues[Home]->Tasks.pop_back();
+					bFound = true;
+				}
+			}
+			for (size_t i = 1; !bFound && i < Queues.size(); i++)
+			{
+				WorkQueue& Victim = *Queues[(Home + i) % Queues.size()];
+				std::lock_guard Lock(Victim.Mutex);
+				if (!Victim.Tasks.empty())
+				{
+					Current = Victim.Tasks.front();
+					Victim.Tasks.pop_front();
+					bFound = true;
+				}
+			}
+			if (!bFound) return false;
+
+			NumQueued.fetch_sub(1, std::memory_order_relaxed);
+			try
+			{
+				Current.Run(Current.Context, Current.Chunk);
+			}
+			catch (...)
+			{
+				std::lock_guard Lock(Current.Owner->ErrorMutex);
+				if (!Current.Owner->Error) Current.Owner->Error = std::current_exception();
+			}
+			Current.Owner->Remaining.fetch_sub(1, std::memory_order_acq_rel);
+			return true;
+		}
+
+		void WorkerLoop(size_t Index)
+		{
+			LocalPool = this;
+			LocalIndex = static_cast<int>(Index);
+			while (true)
+			{
+				if (RunOne(Index)) continue;
+				std::unique_lock Lock(SleepMutex);
+				WakeUp.wait(Lock, [this] { return bStop || NumQueued.load(std::memory_order_relaxed) > 0; });
+				if (bStop) return;
+			}
+		}
+
+		// 현재 thread가 worker라면 그 pool과 index. 모든 pool이 공유하므로 LocalPool과 함께 확인한다.
+		static inline thread_local const ThreadPool* LocalPool = nullptr;
+		static inline thread_local int LocalIndex = -1;
+
+		std::vector<std::unique_ptr<WorkQueue>> Queues;
+		std::vector<std::thread> Workers;
+		std::mutex SleepMutex;
+		std::condition_variable WakeUp;
+		std::atomic<size_t> NumQueued {0};
+		bool bStop = false;
+	};
+
+	void TestThreadPool()
+	{
+		ThreadPool Pool(3);
+		constexpr size_t Count = 1000003;
+		std::vector<int> Values(Count, 1);
+		Pool.ParallelFor(Count, 4096, [&] (size_t Begin, size_t End) {
+			for (size_t i = Begin; i < End; i++) Values[i] += static_cast<int>(i % 3);
+		});
+		const long long Total = Pool.ParallelReduce(Count, 4096, 0LL,
+			[&] (size_t Begin, size_t End) { return std::accumulate(Values.begin() + Begin, Values.begin() + End, 0LL); },
+			[] (long long A, long long B) { return A + B; });
+		CHECK(Total == std::accumulate(Values.begin(), Values.end(), 0LL));
+		CHECK(Values[Count - 1] == 1 + static_cast<int>((Count - 1) % 3));
+
+		// 부분 합을 합치는 순서가 고정되어 있으므로 float 합이 매번 같다.
+		std::vector<float> Floats(Count);
+		for (size_t i = 0; i < Count; i++) Floats[i] = 1.f / static_cast<float>(i + 1);
+		auto FloatSum = [&] {
+			return Pool.ParallelReduce(Count, 4096, 0.f,
+				[&] (size_t Begin, size_t End) { return std::accumulate(Floats.begin() + Begin, Floats.begin() + End, 0.f); },
+				[] (float A, float B) { return A + B; });
+		};
+		const float First = FloatSum();
+		for (int i = 0; i < 20; i++)
+		{
+			const float Again = FloatSum();
+			CHECK(Again == First);
+		}
+
+		bool bThrown = false;
+		try
+		{
+			Pool.ParallelFor(Count, 4096, [] (size_t Begin, size_t) { if (Begin == 4096 * 7) throw std::runtime_error("chunk 7"); });
+		}
+		catch (const std::runtime_error&)
+		{
+			bThrown = true;
+		}
+		CHECK(bThrown);
+
+		// 다른 pool의 worker 안에서 호출해도 그 worker의 index를 이 pool의 queue에 쓰지 않는다.
+		ThreadPool Inner(1);
+		std::atomic<size_t> InnerTotal {0};
+		Pool.ParallelFor(64, 1, [&] (size_t, size_t) {
+			Inner.ParallelFor(100, 10, [&] (size_t Begin, size_t End) { InnerTotal += End - Begin; });
+		});
+		CHECK(InnerTotal == 6400);
+	}
+	REGISTER_TEST(TestThreadPool, "Parallel::TestThreadPool", TestThreadPool);
+}
@@ -0,0 +1,505 @@
+#pragma once
+
+// Lightweight tracing.
+//   TRACE_ZONE("Name");            이 scope의 시작과 길이를 기록한다.
+//   TRACE_COUNTER("Name", Value);  그 시점의 값을 기록한다.
+// 이름은 string literal처럼 프로그램이 끝날 때까지 살아 있는 문자열이어야 한다. 포인터만 저장한다.
+//
+// Tracing::Start()와 Stop() 사이에서만 기록하고, 그 밖에서는 zone 하나가 atomic load 하나다.
+// 기록할 때 시각은 x86에서 rdtsc로 읽고(steady_clock::now의 절반 정도 비용), 내보낼 때
+// Start 시점과 내보내는 시점의 steady_clock으로 ns로 바꾼다. invariant TSC를 가정한다.
+// event는 thread마다 고정 크기 ring buffer에 쌓인다. 쓰는 쪽은 그 buffer를 가진 thread 하나뿐이고
+// 읽는 쪽은 WriteChromeTrace 하나뿐인 SPSC buffer라서 lock이 필요없다.
+// buffer가 가득 차면 새 event를 버리고 DroppedCount를 늘린다.
+//
+// thread가 끝나면 buffer를 반납한다. 남은 event는 그대로 두었다가 내보낼 수 있고, 다 내보낸
+// 반납된 buffer는 다음에 기록을 시작하는 thread가 재사용한다. 따라서 buffer 수는 지금까지 본
+// thread 수가 아니라 동시에 기록하는 thread 수만큼만 늘어난다.
+//
+// WriteChromeTrace는 쌓인 event를 Chrome trace event format(JSON)으로 쓰고 buffer를 비운다.
+// chrome://tracing이나 https://ui.perfetto.dev 에서 열 수 있다.
+// Registry의 --trace=PATH도 이 module을 쓴다.
+//
+// TRACING_ENABLED를 0으로 정의하면 macro가 모두 사라진다. 지정하지 않으면 1이다.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "Registry.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define TRACING_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACING_HAS_TSC 1
+#else
+#define TRACING_HAS_TSC 0
+#endif
+
+#ifndef TRACING_ENABLED
+#define TRACING_ENABLED 1
+#endif
+
+namespace Tracing
+{
+	// thread 하나가 Drain 사이에 쌓을 수 있는 event 수. event는 32 byte이므로 buffer마다 1MB다.
+	inline constexpr size_t EventsPerThread = 1 << 15;
+
+	enum class EPhase : uint8_t { Complete, Counter };
+
+	struct Event
+	{
+		const char* Name;
+		uint64_t Time;   // tick
+		int64_t Value;   // Complete이면 길이(tick), Counter이면 값
+		EPhase Phase;
+	};
+
+	class ThreadBuffer
+	{
+	public:
+		ThreadBuffer() : Events(new Event[EventsPerThread]) {}
+
+		// 이 buffer를 가진 thread만 호출한다.
+		void Push(const Event& NewEvent)
+		{
+			const uint64_t Position = Head.load(std::memory_order_relaxed);
+			if (Position - Tail.load(std::memory_order_acquire) >= EventsPerThread)
+			{
+				Dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			Events[Position & (EventsPerThread - 1)] = NewEvent;
+			Head.store(Position + 1, std::memory_order_release);
+		}
+
+		// 지금까지 쌓인 event를 Visit(ThreadId, Event)에 넘기고 그 자리를 비운다. 한 번에 한 thread만 호출한다.
+		template<class Func>
+		void Drain(Func&& Visit)
+		{
+			const uint64_t Last = Head.load(std::memory_order_acquire);
+			// Head를 읽은 뒤에 읽어야, 재사용된 buffer의 event에 새 주인의 id가 붙는다.
+			const uint32_t Id = ThreadId.load(std::memory_order_relaxed);
+			uint64_t Position = Tail.load(std::memory_order_relaxed);
+			for (; Position != Last; Position++) Visit(Id, Events[Position & (EventsPerThread - 1)]);
+			Tail.store(Last, std::memory_order_release);
+		}
+
+		bool IsDrained() const { return Head.load(std::memory_order_acquire) == Tail.load(std::memory_order_acquire); }
+
+		// 반납되었고 남은 event도 없는 buffer를 차지한다.
+		bool TryAcquire(uint32_t NewThreadId)
+		{
+			bool bExpected = false;
+			if (!IsDrained() || !bInUse.compare_exchange_strong(bExpected, true, std::memory_order_acquire)) return false;
+			if (!IsDrained())
+			{
+				// 확인한 사이에 다른 thread가 차지했다가 event를 남기고 반납했다.
+				bInUse.store(false, std::memory_order_release);
+				return false;
+			}
+			ThreadId.store(NewThreadId, std::memory_order_relaxed);
+			return true;
+		}
+
+		void Release() { bInUse.store(false, std::memory_order_release); }
+
+		ThreadBuffer* Next = nullptr;
+		std::atomic<uint64_t> Dropped {0};
+
+	private:
+		std::unique_ptr<Event[]> Events;
+		std::atomic<uint32_t> ThreadId {0};
+		std::atomic<bool> bInUse {false};
+		alignas(64) std::atomic<uint64_t> Head {0};
+		alignas(64) std::atomic<uint64_t> Tail {0};
+	};
+
+	inline std::atomic<bool> bActive {false};
+	inline std::atomic<uint64_t> OriginNanos {0};
+	inline std::atomic<uint64_t> OriginTicks {0};
+	inline std::atomic<ThreadBuffer*> BufferList {nullptr};
+	inline std::atomic<uint32_t> NumThreads {0};
+	inline std::mutex DrainMutex;
+
+	inline uint64_t Nanos()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	inline uint64_t Ticks()
+	{
+#if TRACING_HAS_TSC
+		return __rdtsc();
+#else
+		return Nanos();
+#endif
+	}
+
+	inline bool IsActive() { return bActive.load(std::memory_order_relaxed); }
+
+	inline void Start()
+	{
+		// 처음 Start한 시점을 trace의 0으로 삼는다.
+		std::lock_guard Lock(DrainMutex);
+		if (OriginTicks.load(std::memory_order_relaxed) == 0)
+		{
+			OriginNanos.store(Nanos(), std::memory_order_relaxed);
+			OriginTicks.store(Ticks(), std::memory_order_relaxed);
+		}
+		bActive.store(true, std::memory_order_release);
+	}
+
+	inline void Stop() { bActive.store(false, std::memory_order_release); }
+
+	// 반납된 buffer를 재사용하고, 없으면 새로 만들어 목록에 넣는다. 목록의 buffer는 해제하지 않는다.
+	inline ThreadBuffer* AcquireBuffer()
+	{
+		const uint32_t ThreadId = NumThreads.fetch_add(1, std::memory_order_relaxed) + 1;
+		for (ThreadBuffer* Buffer = BufferList.load(std::memory_order_acquire); Buffer; Buffer = Buffer->Next)
+			if (Buffer->TryAcquire(ThreadId)) return Buffer;
+
+		ThreadBuffer* NewBuffer = new ThreadBuffer;
+		NewBuffer->TryAcquire(ThreadId);
+		NewBuffer->Next = BufferList.load(std::memory_order_relaxed);
+		while (!BufferList.compare_exchange_weak(NewBuffer->Next, NewBuffer, std::memory_order_release, std::memory_order_relaxed));
+		return NewBuffer;
+	}
+
+	// thread가 끝날 때 buffer를 반납한다.
+	struct BufferOwner
+	{
+		ThreadBuffer* Buffer = nullptr;
+		~BufferOwner();
+	};
+
+	// 아래 둘은 trivially destructible이라서 thread가 끝나는 동안에도 읽을 수 있고, 접근 비용도 싸다.
+	inline thread_local ThreadBuffer* CachedBuffer = nullptr;
+	inline thread_local bool bThreadExiting = false;
+	inline thread_local BufferOwner LocalOwner;
+
+	inline BufferOwner::~BufferOwner()
+	{
+		bThreadExiting = true;
+		CachedBuffer = nullptr;
+		if (Buffer) Buffer->Release();
+		Buffer = nullptr;
+	}
+
+	// 이 thread의 buffer. thread가 끝나는 중이면(다른 thread_local의 소멸자에서 기록하면) nullptr.
+	inline ThreadBuffer* LocalBuffer()
+	{
+		if (CachedBuffer) return CachedBuffer;
+		if (bThreadExiting) return nullptr;
+		LocalOwner.Buffer = AcquireBuffer();
+		CachedBuffer = LocalOwner.Buffer;
+		return CachedBuffer;
+	}
+
+	inline void Record(const Event& NewEvent)
+	{
+		if (ThreadBuffer* Buffer = LocalBuffer()) Buffer->Push(NewEvent);
+	}
+
+	inline void Count(const char* Name, int64_t Value)
+	{
+		if (IsActive()) Record({Name, Ticks(), Value, EPhase::Counter});
+	}
+
+	// 기록 중이면 시작 시각을, 아니면 0을 돌려준다.
+	inline uint64_t BeginZone() { return IsActive() ? Ticks() : 0; }
+
+	inline void EndZone(const char* Name, uint64_t Begin)
+	{
+		if (Begin != 0) Record({Name, Begin, static_cast<int64_t>(Ticks() - Begin), EPhase::Complete});
+	}
+
+	class Zone
+	{
+	public:
+		explicit Zone(const char* InName) : Name(InName), Begin(BeginZone()) {}
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+		~Zone() { EndZone(Name, Begin); }
+
+	private:
+		const char* Name;
+		uint64_t Begin;
+	};
+
+	inline uint64_t DroppedCount()
+	{
+		uint64_t Total = 0;
+		for (ThreadBuffer* Buffer = BufferList.load(std::memory_order_acquire); Buffer; Buffer = Buffer->Next)
+			Total += Buffer->Dropped.load(std::memory_order_relaxed);
+		return Total;
+	}
+
+	inline size_t BufferCount()
+	{
+		size_t Count = 0;
+		for (ThreadBuffer* Buffer = BufferList.load(std::memory_order_acquire); Buffer; Buffer = Buffer->Next) Count++;
+		return Count;
+	}
+
+	// 쌓인 event를 Chrome trace JSON으로 쓰고 buffer를 비운다. 쓴 event 수를 돌려준다.
+	inline size_t WriteChromeTrace(std::ostream& Out)
+	{
+		std::lock_guard Lock(DrainMutex);
+		const uint64_t BaseTicks = OriginTicks.load(std::memory_order_relaxed);
+		const uint64_t ElapsedTicks = Ticks() - BaseTicks;
+		const double NanosPerTick = BaseTicks != 0 && ElapsedTicks != 0
+			? static_cast<double>(Nanos() - OriginNanos.load(std::memory_order_relaxed)) / static_cast<double>(ElapsedTicks) : 1.0;
+		auto Escape = [] (std::string_view Text) {
+			std::string Escaped;
+			for (char c : Text)
+			{
+				if (c == '"' || c == '\\') Escaped += '\\';
+				Escaped += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+			}
+			return Escaped;
+		};
+		// tick을 trace 시작 기준의 µs로 바꾼다.
+		auto Micros = [NanosPerTick] (int64_t Duration) { return static_cast<double>(Duration) * NanosPerTick / 1000.0; };
+
+		size_t NumEvents = 0;
+		bool bFirst = true;
+		char Line[160];
+		Out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		for (ThreadBuffer* Buffer = BufferList.load(std::memory_order_acquire); Buffer; Buffer = Buffer->Next)
+		{
+			uint32_t NamedThread = 0;
+			Buffer->Drain([&] (uint32_t ThreadId, const Event& Each) {
+				if (ThreadId != NamedThread)
+				{
+					std::snprintf(Line, sizeof(Line), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}",
+						ThreadId, ThreadId);
+					Out << (bFirst ? "\n" : ",\n") << Line;
+					bFirst = false;
+					NamedThread = ThreadId;
+				}
+				if (Each.Phase == EPhase::Complete)
+				{
+					std::snprintf(Line, sizeof(Line), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+						ThreadId, Micros(static_cast<int64_t>(Each.Time - BaseTicks)), Micros(Each.Value));
+				}
+				else
+				{
+					std::snprintf(Line, sizeof(Line), "\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+						ThreadId, Micros(static_cast<int64_t>(Each.Time - BaseTicks)), static_cast<long long>(Each.Value));
+				}
+				Out << ",\n{\"name\":\"" << Escape(Each.Name) << Line;
+				NumEvents++;
+			});
+		}
+		Out << "\n]}" << std::endl;
+		return NumEvents;
+	}
+
+	inline bool WriteChromeTrace(const std::string& Path)
+	{
+		std::ofstream Out(Path);
+		if (!Out) return false;
+		WriteChromeTrace(Out);
+		return static_cast<bool>(Out);
+	}
+}
+
+#if TRACING_ENABLED
+#define TRACING_CONCAT_IMPL(A, B) A##B
+#define TRACING_CONCAT(A, B) TRACING_CONCAT_IMPL(A, B)
+#define TRACE_ZONE(Name) const ::Tracing::Zone TRACING_CONCAT(TraceZone_, __LINE__) { Name }
+#define TRACE_COUNTER(Name, Value) ::Tracing::Count(Name, static_cast<int64_t>(Value))
+#else
+#define TRACE_ZONE(Name) ((void)0)
+#define TRACE_COUNTER(Name, Value) ((void)sizeof(Value))
+#endif
+
+namespace Tracing
+{
+	// Registry의 --trace를 이 module로 처리한다.
+	inline const Registry::TracerRegistrar ChromeTracer {{
+		&Start,
+		[] (const std::string& Path) { Stop(); return WriteChromeTrace(Path); },
+		&BeginZone,
+		&EndZone,
+	}};
+
+	inline size_t CountOccurrences(std::string_view Text, std::string_view Pattern)
+	{
+		size_t Count = 0;
+		for (size_t At = Text.find(Pattern); At != std::string_view::npos; At = Text.find(Pattern, At + 1)) Count++;
+		return Count;
+	}
+
+	// Test와 Benchmark는 buffer를 비우면서 검사하므로, 이미 기록 중이면(--trace로 실행하면)
+	// 그 trace를 지우지 않도록 건너뛴다.
+	inline bool SkipWhileTracing(const char* Name)
+	{
+		if (!IsActive()) return false;
+		std::cout << Name << ": skipped because tracing is already active" << std::endl;
+		return true;
+	}
+
+	inline void Test()
+	{
+		if (SkipWhileTracing("Tracing::Test")) return;
+		std::ostringstream Previous;
+		WriteChromeTrace(Previous);
+
+		Start();
+		auto Work = [] {
+			for (int i = 0; i < 10; i++)
+			{
+				TRACE_ZONE("Tracing::Test.Outer");
+				{
+					TRACE_ZONE("Tracing::Test.Inner");
+					TRACE_COUNTER("Tracing::Test.Counter", i);
+				}
+			}
+		};
+		std::thread Other(Work);
+		Work();
+		Other.join();
+		Stop();
+		{
+			TRACE_ZONE("Tracing::Test.Stopped");  // Stop 뒤에는 기록하지 않는다.
+		}
+
+		std::ostringstream Out;
+		const size_t NumEvents = WriteChromeTrace(Out);
+		const std::string Json = Out.str();
+#if TRACING_ENABLED
+		CHECK(NumEvents == 60);
+		CHECK(CountOccurrences(Json, "\"Tracing::Test.Outer\",\"ph\":\"X\"") == 20);
+		CHECK(CountOccurrences(Json, "\"Tracing::Test.Inner\",\"ph\":\"X\"") == 20);
+		CHECK(CountOccurrences(Json, "\"ph\":\"C\"") == 20);
+		CHECK(CountOccurrences(Json, "Tracing::Test.Stopped") == 0);
+#endif
+		CHECK(Json.front() == '{' && Json.find("\n]}") != std::string::npos);
+
+		// 비운 뒤에는 아무것도 남지 않는다.
+		std::ostringstream Empty;
+		const size_t NumLeft = WriteChromeTrace(Empty);
+		CHECK(NumLeft == 0);
+
+		// buffer가 가득 차면 새 event를 버린다.
+		const uint64_t DroppedBefore = DroppedCount();
+		Start();
+		std::thread([] { for (size_t i = 0; i < EventsPerThread + 100; i++) { TRACE_ZONE("Tracing::Test.Overflow"); } }).join();
+		Stop();
+		const size_t NumKept = WriteChromeTrace(Empty);
+#if TRACING_ENABLED
+		CHECK(DroppedCount() - DroppedBefore == 100);
+		CHECK(NumKept == EventsPerThread);
+#endif
+
+		// 끝난 thread의 buffer는 내보낸 뒤에 재사용하므로, 짧은 thread를 많이 만들어도 buffer가 늘지 않는다.
+		Start();
+		const size_t BuffersBefore = BufferCount();
+		size_t NumShortLived = 0;
+		for (int i = 0; i < 20; i++)
+		{
+			std::thread([] { TRACE_ZONE("Tracing::Test.ShortLived"); }).join();
+			std::ostringstream Drained;
+			NumShortLived += WriteChromeTrace(Drained);
+		}
+		Stop();
+		WriteChromeTrace(Empty);
+		CHECK(BufferCount() <= BuffersBefore + 1);
+#if TRACING_ENABLED
+		CHECK(NumShortLived == 20);
+#endif
+		(void)NumEvents;
+		(void)DroppedBefore;
+		(void)NumKept;
+		(void)NumShortLived;
+	}
+	REGISTER_TEST(Test, "Tracing::Test", Test);
+
+	// --trace로 모든 test를 실행하면 각 항목의 zone과 그 안에서 기록한 zone이 모두 남아야 한다.
+	inline void TestTraceAllEntries()
+	{
+		// 안쪽 실행이 이 test를 다시 고르면 여기서 멈춘다.
+		if (SkipWhileTracing("Tracing::TestTraceAllEntries")) return;
+
+		Registry::ScratchDirectory Scratch;
+		const std::string TracePath = Scratch.Path("all.json");
+		std::string TraceArg = "--trace=" + TracePath;
+		char Program[] = "DoodleNote";
+		char Format[] = "--format=csv";
+		char* Args[] = {Program, Format, TraceArg.data()};
+
+		std::ostringstream Report;
+		std::streambuf* Original = std::cout.rdbuf(Report.rdbuf());
+		const int ExitCode = Registry::RunMain(3, Args);
+		std::cout.rdbuf(Original);
+		CHECK(ExitCode != 2);
+
+		std::ifstream In(TracePath);
+		const std::string Json((std::istreambuf_iterator<char>(In)), std::istreambuf_iterator<char>());
+		bool bHasOpenClosed = false;
+		for (const Registry::Entry& Each : Registry::Entries())
+		{
+			if (Each.Kind != Registry::EEntryKind::Test) continue;
+			CHECK(CountOccurrences(Json, "\"" + Each.Name + "\",\"ph\":\"X\"") == 1);
+			bHasOpenClosed = bHasOpenClosed || Each.Name == "Open_Closed_Case::Test";
+		}
+#if TRACING_ENABLED
+		if (bHasOpenClosed) CHECK(CountOccurrences(Json, "\"ProductFilter::Apply\",\"ph\":\"X\"") > 0);
+#endif
+		(void)bHasOpenClosed;
+	}
+	REGISTER_TEST(TestTraceAllEntries, "Tracing::TestTraceAllEntries", TestTraceAllEntries);
+
+	// zone 하나의 비용을 기록하지 않을 때와 기록할 때 잰다.
+	inline void Benchmark()
+	{
+		using namespace std::chrono;
+		constexpr size_t Batch = EventsPerThread / 2;
+		constexpr int NumBatches = 64;
+		if (SkipWhileTracing("Tracing::Benchmark")) return;
+		std::ostringstream Sink;
+		WriteChromeTrace(Sink);
+
+		volatile uint64_t Work = 0;
+		auto Measure = [&] (const char* Name) {
+			double Total = 0;
+			for (int b = 0; b < NumBatches; b++)
+			{
+				const auto Begin = steady_clock::now();
+				for (size_t i = 0; i < Batch; i++)
+				{
+					TRACE_ZONE("Tracing::Benchmark.Zone");
+					Work = Work + i;
+				}
+				Total += duration<double, std::nano>(steady_clock::now() - Begin).count();
+				Sink.str({});
+				WriteChromeTrace(Sink);
+			}
+			std::cout << Name << ": " << Total / (Batch * NumBatches) << " ns/zone" << std::endl;
+		};
+
+		Measure("inactive");
+		Start();
+		Measure("active");
+		Stop();
+		WriteChromeTrace(Sink);
+		std::cout << "dropped: " << DroppedCount() << std::endl;
+	}
+	REGISTER_BENCHMARK(Benchmark, "Tracing::Benchmark", Benchmark);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// LEB128 varint: 한 byte에 7 bit씩, 상위 bit는 다음 byte가 있는지를 나타낸다.
+// 작은 정수일수록 적은 byte를 쓴다. (0..127은 1 byte)
+
+namespace Varint
+{
+	template<class OutputType>
+	void Write(OutputType& Out, uint64_t Value)
+	{
+		while (Value >= 0x80)
+		{
+			Out.push_back(static_cast<char>((Value & 0x7F) | 0x80));
+			Value >>= 7;
+		}
+		Out.push_back(static_cast<char>(Value));
+	}
+
+	// 성공하면 Cursor를 읽은 만큼 옮긴다. End를 넘거나 10 byte를 넘으면 실패한다.
+	inline bool Read(const char*& Cursor, const char* End, uint64_t& Value)
+	{
+		Value = 0;
+		for (int Shift = 0; Shift < 64 && Cursor < End; Shift += 7)
+		{
+			const auto Byte = static_cast<unsigned char>(*Cursor++);
+			Value |= static_cast<uint64_t>(Byte & 0x7F) << Shift;
+			if ((Byte & 0x80) == 0) return true;
+		}
+		return false;
+	}
+}
@@ -6,6 +6,8 @@
 #include <string>
 #include <map>
 #include <cassert>
+#include "Registry.h"
+#include "Tracing.h"
 
 namespace Combination1
 {
@@ -13,6 +15,7 @@ namespace Combination1
 
 	vector<string> F(const string& Str,map<string,vector<string>>& Memo)
 	{
+		TRACE_ZONE("Combination1::F");
 		if (Str.size() == 0) return {};
 		else if (Str.size() == 1) return {string{},string(1,Str[0])};
 
@@ -24,6 +27,7 @@ namespace Combination1
 		{
 			result.push_back(Str[0] + s);
 		}
+		TRACE_COUNTER("Combination1::F.Memo", Memo.size());
 		return result;
 	}
 
@@ -50,6 +54,7 @@ namespace Combination1
 			cout << endl << endl;
 		}
 	}
+	REGISTER_TEST(Test, "Combination1::Test", Test);
 }
 
 namespace Combination2
@@ -59,6 +64,7 @@ namespace Combination2
 
 	void F(string src, string output)
 	{
+		TRACE_ZONE("Combination2::F");
 		cout << output << endl;
 
 		for (int i = 0; i < src.size(); i++)
@@ -69,6 +75,7 @@ namespace Combination2
 
 	void G(const string& src,int f, int l, string output)
 	{
+		TRACE_ZONE("Combination2::G");
 		cout << output << endl;
 
 		for (int i = f; i < l; i++)
@@ -79,6 +86,7 @@ namespace Combination2
 
 	void H(const string& src,int f, int l, vector<string>& outputs, int b)
 	{
+		TRACE_ZONE("Combination2::H");
 		assert(outputs.size() >= 1);
 
 		for (int i = f; i < l; i++)
@@ -100,10 +108,16 @@ namespace Combination2
 		H(source, 0, source.size(), outputs, 0);
 		for (auto& o : outputs) cout << o << endl;
 	}
+	REGISTER_TEST(Test, "Combination2::Test", Test);
 }
 
-
-int main()
+namespace IntegerDivision
 {
-	std::cout << -26 / 5 << ","<< -26 % 5 << std::endl;
+	// C++11부터 정수 나눗셈은 0 쪽으로 버리므로, 나머지의 부호는 피제수를 따른다.
+	void Test()
+	{
+		std::cout << -26 / 5 << ","<< -26 % 5 << std::endl;
+		CHECK(-26 / 5 == -5 && -26 % 5 == -1);
+	}
+	REGISTER_TEST(Test, "IntegerDivision::Test", Test);
 }
\ No newline at end of file
@@ -1,6 +1,24 @@
+// 모든 module의 Test와 Benchmark는 각 header에서 Registry에 등록된다.
+// 예: DoodleNote --list, DoodleNote "Journaling::*", DoodleNote --benchmarks --repeat=5 --format=json
+#include "ComputerProgramming/Contracts.h"
+#include "CppLearning/Destructors.h"
+#include "CppLearning/classical_polymorphism_and_generic_programming.h"
 #include "DesignPattern/DependencyInversion.h"
+#include "DesignPattern/InterfaceSegregation.h"
+#include "DesignPattern/LiskovSubstitution.h"
+#include "DesignPattern/OpenClosed.h"
+#include "DesignPattern/SingleResponsibility.h"
+#include "Implementations/AsyncPersistenceManager.h"
+#include "Implementations/BinaryJournal.h"
+#include "Implementations/ConcurrentJournal.h"
+#include "Implementations/IncrementalPersistence.h"
+#include "Implementations/JournalIndex.h"
+#include "Implementations/JournalLog.h"
+#include "Implementations/MuPuzzleExplorer.h"
+#include "Implementations/combination.h"
+#include "Implementations/Registry.h"
 
-int main()
+int main(int argc, char* argv[])
 {
-	Test();
+	return Registry::RunMain(argc, argv);
 }
\ No newline at end of file